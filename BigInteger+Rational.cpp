@@ -1,23 +1,86 @@
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 class BigInteger {
 private:
-    std::vector<int> array = {0};
+    static inline thread_local std::pmr::memory_resource* scratch = std::pmr::new_delete_resource();
+
+    std::pmr::vector<int> array = std::pmr::vector<int>(1, 0, scratch);
     size_t length = 0;
     bool positive = true;
-    int kBase = static_cast<int>(1e9);
+    static constexpr int kBase = 1000000000;
+    static constexpr size_t kKaratsubaThreshold = 32;
+    static constexpr size_t kParallelThreshold = 1024;
+    static inline size_t multiplication_threads = 1;
 
     void sum_same_sign(const BigInteger& other);
     void sum_dif_sign(const BigInteger& other, int bigger);
     void change_length();
-    size_t binary_search(BigInteger other, BigInteger number);
+    static void divide_magnitudes(const BigInteger& dividend, const BigInteger& divisor,
+                                  BigInteger& quotient, BigInteger& remainder);
+
+    static void add_limbs(int* target, size_t target_size, const int* source, size_t source_size);
+    static void subtract_limbs(int* target, size_t target_size, const int* source, size_t source_size);
+    static void multiply_schoolbook(const int* first, size_t first_size, const int* second, size_t second_size,
+                                    int* result);
+    static void multiply_karatsuba(const int* first, const int* second, size_t size, int* result, size_t threads);
+    static void multiply_limbs(const int* first, size_t first_size, const int* second, size_t second_size,
+                               int* result, size_t threads);
+
+    // |*this| in base 2^32 and the limbs it was computed from; reused while the limbs match.
+    struct BinaryView {
+        std::vector<int> limbs;
+        std::vector<uint32_t> words;
+    };
+    mutable std::shared_ptr<const BinaryView> binary;
+
+    std::vector<uint32_t> binary_magnitude() const;
+    static std::vector<uint32_t> low_words(const int* limbs, size_t size, size_t words);
+    static const BigInteger& power_of_two(size_t exponent);
+    static BigInteger from_binary_magnitude(const std::vector<uint32_t>& words, bool negative);
+    static void twos_complement(std::vector<uint32_t>& words, size_t size, bool negative);
+    static BigInteger from_twos_complement(std::vector<uint32_t> words);
+
+    static void write_varint(std::string& out, uint64_t value);
+    static const char* read_varint(const char* begin, const char* end, uint64_t& value);
+
+    friend class BigIntegerBatch;
+    friend class BigMatrix;
+    friend class MontgomeryContext;
+    friend std::vector<BigInteger> multiplyPolynomials(const std::vector<BigInteger>& first,
+                                                       const std::vector<BigInteger>& second);
+    template <size_t N>
+    friend class ConstBigInteger;
+    template <size_t Bits>
+    friend class WideInt;
 public:
+    static void setMultiplicationThreads(size_t threads) {
+      multiplication_threads = std::max<size_t>(threads, 1);
+    }
+    static std::pmr::memory_resource* setMemoryResource(std::pmr::memory_resource* resource) {
+      std::swap(scratch, resource);
+      return resource;
+    }
+
     BigInteger() {}
     BigInteger(long long number);
-    BigInteger(const BigInteger& other) = default;
+    BigInteger(const BigInteger& other):
+            array(other.array, scratch), length(other.length), positive(other.positive), binary(other.binary) {}
     BigInteger(std::string string);
 
     BigInteger& operator=(const BigInteger& other) = default;
@@ -25,8 +88,21 @@ public:
       return length != 0;
     }
 
-    bool operator==(const BigInteger& other);
-    bool operator!=(const BigInteger& other) {
+    int sign() const {
+      return length == 0 ? 0 : (positive ? 1 : -1);
+    }
+    size_t limbs() const {
+      return length;
+    }
+    double approximate(size_t& shift) const;
+    size_t hash() const {
+      std::string_view bytes(reinterpret_cast<const char*>(array.data()), length * sizeof(int));
+      return std::hash<std::string_view>()(bytes) ^ static_cast<size_t>(sign() < 0);
+    }
+    explicit operator long long() const;
+
+    bool operator==(const BigInteger& other) const;
+    bool operator!=(const BigInteger& other) const {
       return !(*this == other);
     }
     bool operator<(const BigInteger& other) const;
@@ -51,7 +127,9 @@ public:
     BigInteger operator%(const BigInteger& second) const;
 
     std::string toString() const;
-    BigInteger operator-();
+    void writeBinary(std::string& out) const;
+    const char* readBinary(const char* begin, const char* end);
+    BigInteger operator-() const;
     BigInteger& operator++() {
       *this += 1;
       return *this;
@@ -66,9 +144,43 @@ public:
     BigInteger operator+(const BigInteger& second) const;
     BigInteger operator-(const BigInteger& second) const;
 
+    BigInteger operator<<(size_t shift) const;
+    BigInteger operator>>(size_t shift) const;
+    BigInteger& operator<<=(size_t shift) {
+      return *this = *this << shift;
+    }
+    BigInteger& operator>>=(size_t shift) {
+      return *this = *this >> shift;
+    }
+    BigInteger operator&(const BigInteger& second) const;
+    BigInteger operator|(const BigInteger& second) const;
+    BigInteger operator^(const BigInteger& second) const;
+    BigInteger& operator&=(const BigInteger& other) {
+      return *this = *this & other;
+    }
+    BigInteger& operator|=(const BigInteger& other) {
+      return *this = *this | other;
+    }
+    BigInteger& operator^=(const BigInteger& other) {
+      return *this = *this ^ other;
+    }
+    BigInteger operator~() const {
+      BigInteger result(*this);
+      result.positive = !positive or length == 0;
+      result -= 1;
+      return result;
+    }
+
+    size_t bitLength() const;
+    size_t popcount() const;
+    size_t trailingZeros() const;
+    bool testBit(size_t index) const;
+
     ~BigInteger() {}
 };
 
+BigInteger power(BigInteger base, size_t exponent);
+
 void BigInteger::sum_same_sign(const BigInteger& other) {
   int change = 0;
   int new_number = 0;
@@ -142,19 +254,23 @@ void BigInteger::change_length() {
   }
 }
 
-size_t BigInteger::binary_search(BigInteger other, BigInteger number) {
-  size_t start = 0;
-  auto finish = static_cast<size_t>(1e18 + 1);
-  while (start + 1 < finish) {
-    size_t middle = start + ((finish - start) / 2);
-    BigInteger hhh(static_cast<long long>(middle));
-    if (hhh * other > number) {
-      finish = middle;
-    } else {
-      start = middle;
-    }
+// |*this| ~ result * kBase^shift, taken from the three top limbs, relative error below 2^-52.
+double BigInteger::approximate(size_t& shift) const {
+  size_t top = std::min<size_t>(length, 3);
+  shift = length - top;
+  double result = 0;
+  for (size_t i = length; i > shift; --i) {
+    result = result * kBase + array[i - 1];
   }
-  return start;
+  return result;
+}
+
+BigInteger::operator long long() const {
+  long long result = 0;
+  for (size_t i = length; i > 0; --i) {
+    result = result * kBase + array[i - 1];
+  }
+  return positive ? result : -result;
 }
 
 BigInteger::BigInteger(long long int number) {
@@ -202,8 +318,8 @@ BigInteger::BigInteger(std::string string) {
   length = array.size();
 }
 
-bool BigInteger::operator==(const BigInteger& other) {
-  if (length != other.length) {
+bool BigInteger::operator==(const BigInteger& other) const {
+  if (sign() != other.sign() or length != other.length) {
     return false;
   }
   for (size_t i = 0; i < length; ++i) {
@@ -290,49 +406,123 @@ BigInteger& BigInteger::operator-=(const BigInteger& other) {
   return *this;
 }
 
-BigInteger& BigInteger::operator*=(const BigInteger& other) {
-  BigInteger result;
-  for (size_t i = 0; i < length; ++i) {
-    long long change = 0;
-    long long new_number = 0;
-    BigInteger result_i;
-    for (size_t j = 0; j < other.length; ++j) {
-      new_number = static_cast<long long>(array[i]) * static_cast<long long>(other.array[j]) + change;
-      if (j >= result_i.array.size()) {
-        result_i.array.push_back(0);
-      }
-      result_i.array[j] = static_cast<int>(new_number % kBase);
-      change = new_number / kBase;
+void BigInteger::add_limbs(int* target, size_t target_size, const int* source, size_t source_size) {
+  int carry = 0;
+  for (size_t i = 0; i < target_size and (i < source_size or carry != 0); ++i) {
+    int sum = target[i] + carry + (i < source_size ? source[i] : 0);
+    carry = sum >= kBase ? 1 : 0;
+    target[i] = sum - carry * kBase;
+  }
+}
+
+void BigInteger::subtract_limbs(int* target, size_t target_size, const int* source, size_t source_size) {
+  int borrow = 0;
+  for (size_t i = 0; i < target_size and (i < source_size or borrow != 0); ++i) {
+    int difference = target[i] - borrow - (i < source_size ? source[i] : 0);
+    borrow = difference < 0 ? 1 : 0;
+    target[i] = difference + borrow * kBase;
+  }
+}
+
+void BigInteger::multiply_schoolbook(const int* first, size_t first_size, const int* second, size_t second_size,
+                                     int* result) {
+  std::fill(result, result + first_size + second_size, 0);
+  for (size_t i = 0; i < first_size; ++i) {
+    unsigned long long carry = 0;
+    for (size_t j = 0; j < second_size; ++j) {
+      unsigned long long current = static_cast<unsigned long long>(first[i]) * second[j] + result[i + j] + carry;
+      result[i + j] = static_cast<int>(current % kBase);
+      carry = current / kBase;
     }
-    size_t index = other.length;
-    while (change != 0) {
-      if (result_i.array.size() <= index) {
-        result_i.array.push_back(0);
-      }
-      new_number = change;
-      result_i.array[index] = new_number % kBase;
-      change = new_number / kBase;
-      index += 1;
-    }
-    BigInteger result_i_with_zeros;
-    result_i_with_zeros.array = {};
-    for (size_t j = 0; j < i; ++j) {
-      if (j >= result_i_with_zeros.array.size()) {
-        result_i_with_zeros.array.push_back(0);
-      }
+    result[i + second_size] = static_cast<int>(carry);
+  }
+}
+
+// result[0, 2 * size) = first[0, size) * second[0, size); with threads > 1 the two outer
+// products of large enough levels run on their own threads.
+void BigInteger::multiply_karatsuba(const int* first, const int* second, size_t size, int* result,
+                                    size_t threads) {
+  if (size <= kKaratsubaThreshold) {
+    multiply_schoolbook(first, size, second, size, result);
+    return;
+  }
+  size_t half = size / 2;
+  size_t high = size - half;
+  std::pmr::vector<int> first_sum(first + half, first + size, scratch);
+  std::pmr::vector<int> second_sum(second + half, second + size, scratch);
+  first_sum.push_back(0);
+  second_sum.push_back(0);
+  add_limbs(first_sum.data(), high + 1, first, half);
+  add_limbs(second_sum.data(), high + 1, second, half);
+  std::pmr::vector<int> middle(2 * (high + 1), 0, scratch);
+
+  if (threads > 1 and size >= kParallelThreshold) {
+    size_t share = std::max<size_t>(threads / 3, 1);
+    auto low_product = std::async(std::launch::async, [=] {
+      multiply_karatsuba(first, second, half, result, share);
+    });
+    std::future<void> high_product;
+    size_t rest = threads - share;
+    if (rest > 1) {
+      rest -= share;
+      high_product = std::async(std::launch::async, [=] {
+        multiply_karatsuba(first + half, second + half, high, result + 2 * half, share);
+      });
+    } else {
+      multiply_karatsuba(first + half, second + half, high, result + 2 * half, rest);
     }
-    for (size_t j = 0; j < result_i.array.size(); ++j) {
-      result_i_with_zeros.array.push_back(result_i.array[j]);
+    multiply_karatsuba(first_sum.data(), second_sum.data(), high + 1, middle.data(), rest);
+    low_product.get();
+    if (high_product.valid()) {
+      high_product.get();
     }
-    result_i_with_zeros.length = result_i_with_zeros.array.size();
-    result += result_i_with_zeros;
+  } else {
+    multiply_karatsuba(first, second, half, result, 1);
+    multiply_karatsuba(first + half, second + half, high, result + 2 * half, 1);
+    multiply_karatsuba(first_sum.data(), second_sum.data(), high + 1, middle.data(), 1);
+  }
+
+  subtract_limbs(middle.data(), middle.size(), result, 2 * half);
+  subtract_limbs(middle.data(), middle.size(), result + 2 * half, 2 * high);
+  size_t middle_size = middle.size();
+  while (middle_size > 0 and middle[middle_size - 1] == 0) {
+    --middle_size;
+  }
+  add_limbs(result + half, 2 * size - half, middle.data(), middle_size);
+}
+
+void BigInteger::multiply_limbs(const int* first, size_t first_size, const int* second, size_t second_size,
+                                int* result, size_t threads) {
+  if (first_size < second_size) {
+    std::swap(first, second);
+    std::swap(first_size, second_size);
+  }
+  if (second_size <= kKaratsubaThreshold) {
+    multiply_schoolbook(first, first_size, second, second_size, result);
+    return;
+  }
+  if (first_size == second_size) {
+    multiply_karatsuba(first, second, second_size, result, threads);
+    return;
   }
-  result.length = result.array.size();
-  if ((positive and !other.positive) or (!positive and other.positive)) {
-    result.positive = false;
+  std::fill(result, result + first_size + second_size, 0);
+  std::pmr::vector<int> product(2 * second_size, 0, scratch);
+  for (size_t offset = 0; offset < first_size; offset += second_size) {
+    size_t chunk = std::min(second_size, first_size - offset);
+    multiply_limbs(first + offset, chunk, second, second_size, product.data(), threads);
+    add_limbs(result + offset, first_size + second_size - offset, product.data(), chunk + second_size);
   }
-  *this = result;
+}
+
+BigInteger& BigInteger::operator*=(const BigInteger& other) {
+  std::pmr::vector<int> result(length + other.length + 1, 0, array.get_allocator());
+  multiply_limbs(array.data(), length, other.array.data(), other.length, result.data(), multiplication_threads);
+  array = std::move(result);
+  positive = positive == other.positive;
   change_length();
+  if (length == 0) {
+    positive = true;
+  }
   return *this;
 }
 
@@ -342,69 +532,110 @@ BigInteger BigInteger::operator*(const BigInteger& second) const {
   return result;
 }
 
-BigInteger& BigInteger::operator/=(const BigInteger& other) {
-  std::vector<int> result;
-  BigInteger number;
-  BigInteger module_other(other);
-  module_other.positive = true;
-  bool new_positive = true;
-  if ((positive and !other.positive) or (!positive and other.positive)) {
-    new_positive = false;
+// Schoolbook long division of the magnitudes (Knuth, algorithm D): each quotient limb is estimated
+// from the top two limbs of the normalized remainder and corrected at most twice.
+void BigInteger::divide_magnitudes(const BigInteger& dividend, const BigInteger& divisor,
+                                   BigInteger& quotient, BigInteger& remainder) {
+  size_t size = divisor.length;
+  size_t dividend_size = dividend.length;
+  quotient.positive = true;
+  remainder.positive = true;
+  if (dividend_size < size) {
+    quotient.array.assign(1, 0);
+    remainder.array.assign(dividend.array.begin(), dividend.array.begin() + static_cast<std::ptrdiff_t>(dividend_size));
+    remainder.array.push_back(0);
+    quotient.change_length();
+    remainder.change_length();
+    return;
   }
-  positive = true;
-  number.array.resize(std::min(other.length + 1, length));
-  int index = length - 1;
-  for (int i = std::min(other.length + 1, length) - 1; i >= 0; --i) {
-    number.array[i] = array[index];
-    --index;
-  }
-  number.length = number.array.size();
-  bool stop = false;
-  while (true) {
-    while (number < module_other) {
-      if (index >= 0) {
-        result.push_back(0);
-        --index;
-      } else {
-        if (number == 0) {
-          result.push_back(0);
-        }
-        stop = true;
+  if (size == 1) {
+    uint64_t rest = 0;
+    quotient.array.assign(dividend_size, 0);
+    for (size_t i = dividend_size; i > 0; --i) {
+      uint64_t current = rest * kBase + dividend.array[i - 1];
+      quotient.array[i - 1] = static_cast<int>(current / divisor.array[0]);
+      rest = current % divisor.array[0];
+    }
+    remainder.array.assign(1, static_cast<int>(rest));
+    quotient.change_length();
+    remainder.change_length();
+    return;
+  }
+
+  auto factor = static_cast<uint64_t>(kBase / (divisor.array[size - 1] + 1));
+  std::pmr::vector<int> top(dividend_size + 1, 0, scratch);
+  std::pmr::vector<int> bottom(size, 0, scratch);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < dividend_size; ++i) {
+    uint64_t current = dividend.array[i] * factor + carry;
+    top[i] = static_cast<int>(current % kBase);
+    carry = current / kBase;
+  }
+  top[dividend_size] = static_cast<int>(carry);
+  carry = 0;
+  for (size_t i = 0; i < size; ++i) {
+    uint64_t current = divisor.array[i] * factor + carry;
+    bottom[i] = static_cast<int>(current % kBase);
+    carry = current / kBase;
+  }
+
+  quotient.array.assign(dividend_size - size + 1, 0);
+  for (size_t j = dividend_size - size + 1; j > 0; --j) {
+    size_t shift = j - 1;
+    uint64_t head = static_cast<uint64_t>(top[shift + size]) * kBase + top[shift + size - 1];
+    uint64_t estimate = head / bottom[size - 1];
+    uint64_t rest = head % bottom[size - 1];
+    while (estimate >= static_cast<uint64_t>(kBase) or
+           estimate * bottom[size - 2] > rest * kBase + top[shift + size - 2]) {
+      --estimate;
+      rest += bottom[size - 1];
+      if (rest >= static_cast<uint64_t>(kBase)) {
         break;
       }
     }
-    if (stop) {
-      break;
-    }
-    number.positive = true;
-    long long half = binary_search(module_other, number);
-    number -= static_cast<BigInteger>(half) * module_other;
-    if (half >= kBase) {
-      result.push_back(half / kBase);
-    }
-    result.push_back(half % kBase);
-    if (index < 0) {
-      break;
-    }
-    BigInteger new_number;
-    new_number.array.resize(number.array.size() + 1);
-    new_number.array[0] = array[index];
-    --index;
-    for (size_t i = 0; i < number.length; ++i) {
-      new_number.array[i + 1] = number.array[i];
+    long long borrow = 0;
+    carry = 0;
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t product = estimate * bottom[i] + carry;
+      carry = product / kBase;
+      long long difference = top[shift + i] - static_cast<long long>(product % kBase) - borrow;
+      borrow = difference < 0 ? 1 : 0;
+      top[shift + i] = static_cast<int>(difference + borrow * kBase);
     }
-    number = new_number;
-    number.length = 0;
-    for (size_t i = 0; i < number.array.size(); ++i) {
-      if (number.array[i] != 0) {
-        number.length = i + 1;
+    long long head_difference = top[shift + size] - static_cast<long long>(carry) - borrow;
+    if (head_difference < 0) {
+      --estimate;
+      int add_carry = 0;
+      for (size_t i = 0; i < size; ++i) {
+        int sum = top[shift + i] + bottom[i] + add_carry;
+        add_carry = sum >= kBase ? 1 : 0;
+        top[shift + i] = sum - add_carry * kBase;
       }
+      head_difference += add_carry;
     }
+    top[shift + size] = static_cast<int>(head_difference);
+    quotient.array[shift] = static_cast<int>(estimate);
   }
-  std::reverse(result.begin(), result.end());
-  array = result;
-  positive = new_positive;
-  change_length();
+
+  remainder.array.assign(size, 0);
+  uint64_t rest = 0;
+  for (size_t i = size; i > 0; --i) {
+    uint64_t current = rest * kBase + top[i - 1];
+    remainder.array[i - 1] = static_cast<int>(current / factor);
+    rest = current % factor;
+  }
+  quotient.change_length();
+  remainder.change_length();
+}
+
+BigInteger& BigInteger::operator/=(const BigInteger& other) {
+  BigInteger quotient;
+  BigInteger remainder;
+  divide_magnitudes(*this, other, quotient, remainder);
+  bool negative = positive != other.positive;
+  array = quotient.array;
+  length = quotient.length;
+  positive = !negative or length == 0;
   return *this;
 }
 
@@ -415,9 +646,12 @@ BigInteger BigInteger::operator/(const BigInteger& second) const {
 }
 
 BigInteger& BigInteger::operator%=(const BigInteger& other) {
-  BigInteger division = *this / other;
-  division *= other;
-  *this = *this - division;
+  BigInteger quotient;
+  BigInteger remainder;
+  divide_magnitudes(*this, other, quotient, remainder);
+  array = remainder.array;
+  length = remainder.length;
+  positive = positive or length == 0;
   return *this;
 }
 
@@ -451,7 +685,346 @@ std::string BigInteger::toString() const {
   return BigInt;
 }
 
-BigInteger BigInteger::operator-() {
+// |*this| in base 2^32, least significant word first, without leading zero words. The conversion
+// is quadratic, so the result is kept with the limbs it came from and reused while they match.
+std::vector<uint32_t> BigInteger::binary_magnitude() const {
+  if (binary != nullptr and binary->limbs.size() == length and
+      std::equal(array.begin(), array.begin() + static_cast<std::ptrdiff_t>(length), binary->limbs.begin())) {
+    return binary->words;
+  }
+  std::vector<uint32_t> rest(array.begin(), array.begin() + static_cast<std::ptrdiff_t>(length));
+  std::vector<uint32_t> words;
+  while (!rest.empty()) {
+    uint64_t remainder = 0;
+    for (size_t i = rest.size(); i > 0; --i) {
+      uint64_t current = remainder * kBase + rest[i - 1];
+      rest[i - 1] = static_cast<uint32_t>(current >> 32);
+      remainder = current & 0xFFFFFFFFULL;
+    }
+    words.push_back(static_cast<uint32_t>(remainder));
+    while (!rest.empty() and rest.back() == 0) {
+      rest.pop_back();
+    }
+  }
+  binary = std::make_shared<const BinaryView>(BinaryView{
+      std::vector<int>(array.begin(), array.begin() + static_cast<std::ptrdiff_t>(length)), words});
+  return words;
+}
+
+// The number held in limbs modulo 2^(32 * words). 1e9 = 2^9 * 5^9, so only the limbs below
+// 32 * words / 9 contribute: O(words^2) whatever the size of the number.
+std::vector<uint32_t> BigInteger::low_words(const int* limbs, size_t size, size_t words) {
+  std::vector<uint32_t> result(words, 0);
+  std::vector<uint32_t> scale(words, 0);
+  scale[0] = 1;
+  for (size_t j = 0; j < size and 9 * j < 32 * words; ++j) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < words; ++i) {
+      carry += result[i] + static_cast<uint64_t>(scale[i]) * static_cast<uint32_t>(limbs[j]);
+      result[i] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+    carry = 0;
+    for (size_t i = 0; i < words; ++i) {
+      carry += static_cast<uint64_t>(scale[i]) * kBase;
+      scale[i] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+  }
+  return result;
+}
+
+// 2^exponent, memoized per thread. The entries are built outside any BigIntegerArena, which
+// could otherwise be gone by the next call.
+const BigInteger& BigInteger::power_of_two(size_t exponent) {
+  static thread_local std::unordered_map<size_t, BigInteger> cache;
+  auto found = cache.find(exponent);
+  if (found != cache.end()) {
+    return found->second;
+  }
+  if (cache.size() >= 64) {
+    cache.clear();
+  }
+  std::pmr::memory_resource* previous = setMemoryResource(std::pmr::new_delete_resource());
+  auto inserted = cache.emplace(exponent, power(2, exponent)).first;
+  setMemoryResource(previous);
+  return inserted->second;
+}
+
+BigInteger BigInteger::from_binary_magnitude(const std::vector<uint32_t>& words, bool negative) {
+  BigInteger result;
+  result.array.clear();
+  for (size_t i = words.size(); i > 0; --i) {
+    uint64_t carry = words[i - 1];
+    for (auto& limb : result.array) {
+      uint64_t current = (static_cast<uint64_t>(limb) << 32) + carry;
+      limb = static_cast<int>(current % kBase);
+      carry = current / kBase;
+    }
+    for (; carry != 0; carry /= kBase) {
+      result.array.push_back(static_cast<int>(carry % kBase));
+    }
+  }
+  if (result.array.empty()) {
+    result.array.push_back(0);
+  }
+  result.change_length();
+  result.positive = !negative or result.length == 0;
+  std::vector<uint32_t> significant = words;
+  while (!significant.empty() and significant.back() == 0) {
+    significant.pop_back();
+  }
+  result.binary = std::make_shared<const BinaryView>(BinaryView{
+      std::vector<int>(result.array.begin(), result.array.begin() + static_cast<std::ptrdiff_t>(result.length)),
+      std::move(significant)});
+  return result;
+}
+
+// Turns a binary magnitude into its two's complement on size words, in place.
+void BigInteger::twos_complement(std::vector<uint32_t>& words, size_t size, bool negative) {
+  words.resize(size, 0);
+  if (negative) {
+    uint64_t carry = 1;
+    for (auto& word : words) {
+      carry += static_cast<uint32_t>(~word);
+      word = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+  }
+}
+
+BigInteger BigInteger::from_twos_complement(std::vector<uint32_t> words) {
+  bool negative = !words.empty() and (words.back() >> 31) != 0;
+  if (negative) {
+    uint64_t carry = 1;
+    for (auto& word : words) {
+      carry += static_cast<uint32_t>(~word);
+      word = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+  }
+  return from_binary_magnitude(words, negative);
+}
+
+// One multiplication by 2^shift; below 2^30 the factor is a single limb.
+BigInteger BigInteger::operator<<(size_t shift) const {
+  if (shift < 30) {
+    return *this * BigInteger(1LL << shift);
+  }
+  return *this * power_of_two(shift);
+}
+
+// Arithmetic shift: one division by 2^shift, rounded towards minus infinity like the two's
+// complement shift does.
+BigInteger BigInteger::operator>>(size_t shift) const {
+  if (shift >= bitLength()) {
+    return sign() < 0 ? BigInteger(-1) : BigInteger(0);
+  }
+  BigInteger quotient;
+  BigInteger remainder;
+  divide_magnitudes(*this, shift < 30 ? BigInteger(1LL << shift) : power_of_two(shift), quotient, remainder);
+  if (sign() < 0) {
+    if (remainder.length != 0) {
+      quotient += 1;
+    }
+    quotient.positive = quotient.length == 0;
+  }
+  return quotient;
+}
+
+BigInteger BigInteger::operator&(const BigInteger& second) const {
+  std::vector<uint32_t> result = binary_magnitude();
+  std::vector<uint32_t> other = second.binary_magnitude();
+  size_t words = std::max(result.size(), other.size()) + 1;
+  twos_complement(result, words, sign() < 0);
+  twos_complement(other, words, second.sign() < 0);
+  for (size_t i = 0; i < words; ++i) {
+    result[i] &= other[i];
+  }
+  return from_twos_complement(std::move(result));
+}
+
+BigInteger BigInteger::operator|(const BigInteger& second) const {
+  std::vector<uint32_t> result = binary_magnitude();
+  std::vector<uint32_t> other = second.binary_magnitude();
+  size_t words = std::max(result.size(), other.size()) + 1;
+  twos_complement(result, words, sign() < 0);
+  twos_complement(other, words, second.sign() < 0);
+  for (size_t i = 0; i < words; ++i) {
+    result[i] |= other[i];
+  }
+  return from_twos_complement(std::move(result));
+}
+
+BigInteger BigInteger::operator^(const BigInteger& second) const {
+  std::vector<uint32_t> result = binary_magnitude();
+  std::vector<uint32_t> other = second.binary_magnitude();
+  size_t words = std::max(result.size(), other.size()) + 1;
+  twos_complement(result, words, sign() < 0);
+  twos_complement(other, words, second.sign() < 0);
+  for (size_t i = 0; i < words; ++i) {
+    result[i] ^= other[i];
+  }
+  return from_twos_complement(std::move(result));
+}
+
+// bitLength, popcount and trailingZeros describe |*this|; testBit uses two's complement.
+// bitLength reads the top limbs as a double and only compares against 2^k when the estimate
+// lands too close to an integer to trust.
+size_t BigInteger::bitLength() const {
+  if (length == 0) {
+    return 0;
+  }
+  size_t shift = 0;
+  double estimate = std::log2(approximate(shift)) + static_cast<double>(shift) * std::log2(static_cast<double>(kBase));
+  double nearest = std::round(estimate);
+  if (std::abs(estimate - nearest) > 1e-9 + estimate * 1e-14) {
+    return static_cast<size_t>(estimate) + 1;
+  }
+  const BigInteger& bound = power_of_two(static_cast<size_t>(nearest));
+  bool below = length != bound.length ? length < bound.length
+                                      : std::lexicographical_compare(
+                                            array.rbegin() + static_cast<std::ptrdiff_t>(array.size() - length), array.rend(),
+                                            bound.array.rbegin() + static_cast<std::ptrdiff_t>(bound.array.size() - length),
+                                            bound.array.rend());
+  return static_cast<size_t>(nearest) + (below ? 0 : 1);
+}
+
+size_t BigInteger::popcount() const {
+  size_t result = 0;
+  for (uint32_t word : binary_magnitude()) {
+    result += std::popcount(word);
+  }
+  return result;
+}
+
+// 1e9^i = 2^(9i) * 5^(9i): the lowest nonzero limb settles the answer unless it is itself a
+// multiple of 2^9, in which case the limbs above it are read modulo growing powers of two.
+size_t BigInteger::trailingZeros() const {
+  size_t lowest = 0;
+  while (lowest < length and array[lowest] == 0) {
+    ++lowest;
+  }
+  if (lowest == length) {
+    return 0;
+  }
+  if (std::countr_zero(static_cast<uint32_t>(array[lowest])) < 9) {
+    return 9 * lowest + std::countr_zero(static_cast<uint32_t>(array[lowest]));
+  }
+  for (size_t words = 2;; words *= 2) {
+    std::vector<uint32_t> low = low_words(array.data() + lowest, length - lowest, words);
+    for (size_t i = 0; i < words; ++i) {
+      if (low[i] != 0) {
+        return 9 * lowest + 32 * i + std::countr_zero(low[i]);
+      }
+    }
+  }
+}
+
+// Only the words up to index are needed: the low part of |*this|, negated modulo 2^(32 * words)
+// for negative numbers.
+bool BigInteger::testBit(size_t index) const {
+  if (index >= bitLength()) {
+    return sign() < 0;
+  }
+  size_t words = index / 32 + 1;
+  std::vector<uint32_t> low = low_words(array.data(), length, words);
+  twos_complement(low, words, sign() < 0);
+  return ((low[index / 32] >> (index % 32)) & 1) != 0;
+}
+
+void BigInteger::write_varint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+const char* BigInteger::read_varint(const char* begin, const char* end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; begin != end and shift < 64; shift += 7) {
+    auto byte = static_cast<unsigned char>(*begin++);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return begin;
+    }
+  }
+  return nullptr;
+}
+
+// Wire format: a varint header. If its low bit is 0, the rest of it is the zigzag encoded value
+// (|value| < 2^62); otherwise it is (limb count << 2 | negative << 1 | 1) followed by that many
+// little-endian 32-bit base-1e9 limbs.
+void BigInteger::writeBinary(std::string& out) const {
+  if (length <= 2) {
+    auto value = static_cast<long long>(*this);
+    auto zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    write_varint(out, zigzag << 1);
+    return;
+  }
+  write_varint(out, (static_cast<uint64_t>(length) << 2) | (positive ? 0 : 2) | 1);
+  size_t offset = out.size();
+  out.resize(offset + 4 * length);
+  if constexpr (std::endian::native == std::endian::little) {
+    std::memcpy(out.data() + offset, array.data(), 4 * length);
+  } else {
+    for (size_t i = 0; i < length; ++i) {
+      for (size_t byte = 0; byte < 4; ++byte) {
+        out[offset + 4 * i + byte] = static_cast<char>(static_cast<uint32_t>(array[i]) >> (8 * byte));
+      }
+    }
+  }
+}
+
+// Decodes one value into *this, reusing its limb storage. Returns the position after it, or
+// nullptr if [begin, end) does not hold a complete value, in which case *this is unchanged.
+const char* BigInteger::readBinary(const char* begin, const char* end) {
+  uint64_t header;
+  begin = read_varint(begin, end, header);
+  if (begin == nullptr) {
+    return nullptr;
+  }
+  uint64_t count = header >> 2;
+  if ((header & 1) != 0 and static_cast<uint64_t>(end - begin) / 4 < count) {
+    return nullptr;
+  }
+  array.clear();
+  if ((header & 1) == 0) {
+    uint64_t zigzag = header >> 1;
+    bool negative = (zigzag & 1) != 0;
+    uint64_t magnitude = negative ? (zigzag >> 1) + 1 : zigzag >> 1;
+    for (; magnitude != 0; magnitude /= kBase) {
+      array.push_back(static_cast<int>(magnitude % kBase));
+    }
+    positive = !negative;
+  } else {
+    array.resize(count);
+    if constexpr (std::endian::native == std::endian::little) {
+      std::memcpy(array.data(), begin, 4 * count);
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        uint32_t limb = 0;
+        for (size_t byte = 0; byte < 4; ++byte) {
+          limb |= static_cast<uint32_t>(static_cast<unsigned char>(begin[4 * i + byte])) << (8 * byte);
+        }
+        array[i] = static_cast<int>(limb);
+      }
+    }
+    begin += 4 * count;
+    positive = (header & 2) == 0;
+  }
+  if (array.empty()) {
+    array.push_back(0);
+  }
+  change_length();
+  if (length == 0) {
+    positive = true;
+  }
+  return begin;
+}
+
+BigInteger BigInteger::operator-() const {
   BigInteger bigint(*this);
   bigint.positive = !bigint.positive;
   return bigint;
@@ -529,115 +1102,1510 @@ BigInteger operator""_bi(const char* string) {
   return bigint;
 }
 
-class Rational {
-private:
-    BigInteger numerator = 0;
-    BigInteger denominator = 1;
-    void reduction();
-public:
-    Rational() {}
-    Rational(long long number);
-    Rational(BigInteger number) {
-      numerator = number;
-      denominator = 1;
+BigInteger power(BigInteger base, size_t exponent) {
+  BigInteger result = 1;
+  while (exponent != 0) {
+    if (exponent % 2 == 1) {
+      result *= base;
     }
-    Rational(const Rational& other) = default;
-
-    Rational& operator=(const Rational& other) = default;
-
-    Rational operator-();
-
-    Rational& operator+=(const Rational& other);
-    Rational& operator-=(const Rational& other);
-    Rational& operator*=(const Rational& other);
-    Rational& operator/=(const Rational& other);
+    exponent /= 2;
+    if (exponent != 0) {
+      base *= base;
+    }
+  }
+  return result;
+}
 
-    Rational operator+(const Rational& second) const;
-    Rational operator-(const Rational& second) const;
-    Rational operator*(const Rational& second) const;
-    Rational operator/(const Rational& second) const;
+BigInteger gcd(BigInteger first, BigInteger second) {
+  if (first.sign() < 0) {
+    first = -first;
+  }
+  if (second.sign() < 0) {
+    second = -second;
+  }
+  while (second.sign() != 0) {
+    first %= second;
+    std::swap(first, second);
+  }
+  return first;
+}
 
-    bool operator==(const Rational& other) {
-      return numerator * other.denominator == other.numerator * denominator;
-    }
-    bool operator!=(const Rational& other) {
-      return !(*this == other);
-    }
-    bool operator<(const Rational& other) const;
-    bool operator>(const Rational& other) const {
-      return other < *this;
-    }
-    bool operator>=(const Rational& other) const {
-      return !(*this < other);
-    }
-    bool operator<=(const Rational& other) const {
-      return !(other < *this);
+BigInteger isqrt(const BigInteger& number) {
+  if (number.sign() < 0) {
+    throw std::domain_error("isqrt of a negative number");
+  }
+  if (number.sign() == 0) {
+    return 0;
+  }
+  size_t shift;
+  double top = number.approximate(shift);
+  if (shift % 2 == 1) {
+    top *= 1e9;
+    --shift;
+  }
+  // Newton's iteration decreases monotonically from any starting point above the root.
+  BigInteger current = static_cast<long long>(std::sqrt(top) * (1 + 1e-9)) + 1;
+  current *= power(1000000000, shift / 2);
+  while (true) {
+    BigInteger next = (current + number / current) / 2;
+    if (!(next < current)) {
+      return current;
     }
+    current = next;
+  }
+}
 
-    std::string asDecimal(size_t precision = 0) const;
-    std::string toString();
-    
-    explicit operator double() const {
-      std::string string = asDecimal(20);
-      return std::stod(string);
+BigInteger iroot(const BigInteger& number, size_t degree) {
+  if (degree == 0) {
+    throw std::domain_error("root of degree 0");
+  }
+  if (number.sign() < 0) {
+    if (degree % 2 == 0) {
+      throw std::domain_error("even root of a negative number");
     }
-};
-
-void Rational::reduction() {
-  BigInteger first(numerator);
-  if (numerator < 0) {
-    first = -first;
+    return -iroot(-number, degree);
   }
-  BigInteger second(denominator);
-  while (first > 0 and second > 0) {
-    if (first > second) {
-      first %= second;
-    } else {
-      second %= first;
+  if (degree == 1 or number.sign() == 0) {
+    return number;
+  }
+  if (degree == 2) {
+    return isqrt(number);
+  }
+  size_t shift;
+  double top = number.approximate(shift);
+  double digits = (std::log10(top) + 9.0 * static_cast<double>(shift)) / static_cast<double>(degree);
+  auto whole = static_cast<long long>(std::floor(digits));
+  BigInteger current = static_cast<long long>(std::pow(10.0, digits - static_cast<double>(whole) + 14) * (1 + 1e-6)) + 1;
+  if (whole >= 14) {
+    current *= power(10, whole - 14);
+  } else {
+    current = current / power(10, 14 - whole) + 1;
+  }
+  BigInteger lower_degree = static_cast<long long>(degree - 1);
+  BigInteger full_degree = static_cast<long long>(degree);
+  while (true) {
+    BigInteger next = (current * lower_degree + number / power(current, degree - 1)) / full_degree;
+    if (!(next < current)) {
+      return current;
     }
+    current = next;
   }
-  BigInteger gcd(first + second);
-  numerator /= gcd;
-  denominator /= gcd;
 }
 
-Rational::Rational(long long int number) {
-  BigInteger new_number(number);
-  numerator = new_number;
-  denominator = 1;
-}
+// Montgomery arithmetic modulo an odd modulus coprime to 10, with R = kBase^size. Build it once
+// and reuse it for every exponentiation or witness modulo the same number.
+class MontgomeryContext {
+private:
+    static constexpr int kBase = BigInteger::kBase;
+
+    BigInteger modulus;
+    size_t size;
+    uint64_t inverse;
+    std::vector<int> modulus_limbs;
+    std::vector<int> one;
+    std::vector<int> minus_one;
+    std::vector<int> r_squared;
+    BigInteger odd_part;
+    size_t twos;
+
+    std::vector<int> limbs(const BigInteger& number) const;
+    BigInteger value(const std::vector<int>& limbs) const;
+    void multiply(const std::vector<int>& first, const std::vector<int>& second, std::vector<int>& result,
+                  std::vector<int>& product) const;
+    std::vector<int> power_limbs(const BigInteger& base, const BigInteger& exponent) const;
+public:
+    explicit MontgomeryContext(const BigInteger& modulus);
+
+    const BigInteger& getModulus() const {
+      return modulus;
+    }
+    BigInteger multiply(const BigInteger& first, const BigInteger& second) const;
+    BigInteger power(const BigInteger& base, const BigInteger& exponent) const;
+    bool isStrongProbablePrime(const BigInteger& base) const;
+};
+
+MontgomeryContext::MontgomeryContext(const BigInteger& modulus): modulus(modulus), size(modulus.length) {
+  modulus_limbs.assign(modulus.array.begin(), modulus.array.begin() + static_cast<std::ptrdiff_t>(size));
+  long long previous = kBase;
+  long long current = modulus_limbs[0];
+  long long previous_coefficient = 0;
+  long long coefficient = 1;
+  while (current != 0) {
+    long long quotient = previous / current;
+    previous -= quotient * current;
+    std::swap(previous, current);
+    previous_coefficient -= quotient * coefficient;
+    std::swap(previous_coefficient, coefficient);
+  }
+  inverse = static_cast<uint64_t>((kBase - previous_coefficient % kBase) % kBase);
+  BigInteger r_modulo = ::power(kBase, size) % modulus;
+  one = limbs(r_modulo);
+  minus_one = limbs(modulus - r_modulo);
+  r_squared = limbs(r_modulo * r_modulo % modulus);
+  BigInteger minus_one_value = modulus - 1;
+  twos = minus_one_value.trailingZeros();
+  odd_part = minus_one_value >> twos;
+}
+
+std::vector<int> MontgomeryContext::limbs(const BigInteger& number) const {
+  std::vector<int> result(number.array.begin(), number.array.begin() + static_cast<std::ptrdiff_t>(number.length));
+  result.resize(size, 0);
+  return result;
+}
+
+BigInteger MontgomeryContext::value(const std::vector<int>& limbs) const {
+  BigInteger result;
+  result.array.assign(limbs.begin(), limbs.end());
+  result.change_length();
+  return result;
+}
+
+// result = first * second / R mod modulus (REDC), product is scratch space.
+void MontgomeryContext::multiply(const std::vector<int>& first, const std::vector<int>& second,
+                                 std::vector<int>& result, std::vector<int>& product) const {
+  product.assign(2 * size + 1, 0);
+  BigInteger::multiply_limbs(first.data(), size, second.data(), size, product.data(), 1);
+  for (size_t i = 0; i < size; ++i) {
+    uint64_t factor = static_cast<uint64_t>(product[i]) * inverse % kBase;
+    uint64_t carry = 0;
+    for (size_t j = 0; j < size; ++j) {
+      uint64_t current = product[i + j] + factor * modulus_limbs[j] + carry;
+      product[i + j] = static_cast<int>(current % kBase);
+      carry = current / kBase;
+    }
+    for (size_t k = i + size; carry != 0; ++k) {
+      uint64_t current = product[k] + carry;
+      product[k] = static_cast<int>(current % kBase);
+      carry = current / kBase;
+    }
+  }
+  bool reduce = product[2 * size] != 0;
+  for (size_t i = size; i > 0 and !reduce; --i) {
+    if (product[size + i - 1] != modulus_limbs[i - 1]) {
+      reduce = product[size + i - 1] > modulus_limbs[i - 1];
+      break;
+    }
+    reduce = i == 1;
+  }
+  if (reduce) {
+    BigInteger::subtract_limbs(product.data() + size, size + 1, modulus_limbs.data(), size);
+  }
+  result.assign(product.begin() + static_cast<std::ptrdiff_t>(size),
+                product.begin() + static_cast<std::ptrdiff_t>(2 * size));
+}
+
+std::vector<int> MontgomeryContext::power_limbs(const BigInteger& base, const BigInteger& exponent) const {
+  BigInteger reduced = base % modulus;
+  if (reduced.sign() < 0) {
+    reduced += modulus;
+  }
+  std::vector<int> product;
+  std::vector<int> current;
+  multiply(limbs(reduced), r_squared, current, product);
+  std::vector<int> result = one;
+  std::vector<uint32_t> words = exponent.binary_magnitude();
+  for (size_t i = words.size(); i > 0; --i) {
+    for (int bit = 31; bit >= 0; --bit) {
+      multiply(result, result, result, product);
+      if (((words[i - 1] >> bit) & 1) != 0) {
+        multiply(result, current, result, product);
+      }
+    }
+  }
+  return result;
+}
+
+BigInteger MontgomeryContext::multiply(const BigInteger& first, const BigInteger& second) const {
+  return first * second % modulus;
+}
+
+BigInteger MontgomeryContext::power(const BigInteger& base, const BigInteger& exponent) const {
+  std::vector<int> unit(size, 0);
+  unit[0] = 1;
+  std::vector<int> product;
+  std::vector<int> result;
+  multiply(power_limbs(base, exponent), unit, result, product);
+  return value(result);
+}
+
+bool MontgomeryContext::isStrongProbablePrime(const BigInteger& base) const {
+  std::vector<int> current = power_limbs(base, odd_part);
+  if (current == one or current == minus_one) {
+    return true;
+  }
+  std::vector<int> product;
+  for (size_t i = 1; i < twos; ++i) {
+    multiply(current, current, current, product);
+    if (current == minus_one) {
+      return true;
+    }
+    if (current == one) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Jacobi symbol (number / modulus) for odd positive modulus.
+int jacobi(long long number, const BigInteger& modulus) {
+  int result = 1;
+  auto modulus_eight = static_cast<long long>(modulus % 8);
+  if (number < 0) {
+    number = -number;
+    if (modulus_eight % 4 == 3) {
+      result = -result;
+    }
+  }
+  if (number == 0) {
+    return modulus == 1 ? 1 : 0;
+  }
+  while (number % 2 == 0) {
+    number /= 2;
+    if (modulus_eight == 3 or modulus_eight == 5) {
+      result = -result;
+    }
+  }
+  if (number % 4 == 3 and modulus_eight % 4 == 3) {
+    result = -result;
+  }
+  long long first = static_cast<long long>(modulus % number);
+  long long second = number;
+  while (first != 0) {
+    while (first % 2 == 0) {
+      first /= 2;
+      if (second % 8 == 3 or second % 8 == 5) {
+        result = -result;
+      }
+    }
+    std::swap(first, second);
+    if (first % 4 == 3 and second % 4 == 3) {
+      result = -result;
+    }
+    first %= second;
+  }
+  return second == 1 ? result : 0;
+}
+
+bool isStrongLucasProbablePrime(const BigInteger& number) {
+  BigInteger root = isqrt(number);
+  if (root * root == number) {
+    return false;
+  }
+  long long discriminant = 5;
+  while (jacobi(discriminant, number) != -1) {
+    discriminant = discriminant > 0 ? -discriminant - 2 : -discriminant + 2;
+  }
+  const BigInteger p = 1;
+  const BigInteger q = (1 - discriminant) / 4;
+  const BigInteger d = discriminant;
+  auto reduce = [&number](BigInteger value) {
+    value %= number;
+    if (value.sign() < 0) {
+      value += number;
+    }
+    return value;
+  };
+  auto halve = [&number](BigInteger value) {
+    if (static_cast<long long>(value % 2) != 0) {
+      value += number;
+    }
+    return value / 2;
+  };
+  BigInteger plus_one = number + 1;
+  size_t twos = plus_one.trailingZeros();
+  BigInteger odd_part = plus_one >> twos;
+  size_t bits = odd_part.bitLength();
+  BigInteger u = 1;
+  BigInteger v = p;
+  BigInteger q_power = reduce(q);
+  for (size_t bit = bits - 1; bit > 0; --bit) {
+    u = reduce(u * v);
+    v = reduce(v * v - 2 * q_power);
+    q_power = reduce(q_power * q_power);
+    if (odd_part.testBit(bit - 1)) {
+      BigInteger next_u = halve(reduce(p * u + v));
+      v = halve(reduce(d * u + p * v));
+      u = next_u;
+      q_power = reduce(q_power * q);
+    }
+  }
+  if (u.sign() == 0 or v.sign() == 0) {
+    return true;
+  }
+  for (size_t i = 1; i < twos; ++i) {
+    v = reduce(v * v - 2 * q_power);
+    if (v.sign() == 0) {
+      return true;
+    }
+    q_power = reduce(q_power * q_power);
+  }
+  return false;
+}
+
+// Baillie-PSW: trial division, a strong base-2 test and a strong Lucas test. Extra rounds add
+// Miller-Rabin witnesses 3, 5, 7, ... sharing the same Montgomery context.
+bool isProbablePrime(const BigInteger& number, size_t rounds = 0) {
+  if (number < 2) {
+    return false;
+  }
+  static const std::vector<int> small_primes = [] {
+    std::vector<int> primes;
+    for (int candidate = 2; candidate < 1000; ++candidate) {
+      bool prime = true;
+      for (int divisor : primes) {
+        prime = prime and candidate % divisor != 0;
+      }
+      if (prime) {
+        primes.push_back(candidate);
+      }
+    }
+    return primes;
+  }();
+  for (int prime : small_primes) {
+    if (number == prime) {
+      return true;
+    }
+    if ((number % prime).sign() == 0) {
+      return false;
+    }
+  }
+  if (number < 1000 * 1000) {
+    return true;
+  }
+  MontgomeryContext context(number);
+  if (!context.isStrongProbablePrime(2)) {
+    return false;
+  }
+  for (size_t i = 1; i <= rounds and i < small_primes.size(); ++i) {
+    if (!context.isStrongProbablePrime(small_primes[i])) {
+      return false;
+    }
+  }
+  return isStrongLucasProbablePrime(number);
+}
+
+// Fixed-capacity BigInteger with the same base-1e9 limbs, usable in constant expressions:
+// constexpr auto value = 123456789012345678901234567890_cbi; BigInteger runtime = value;
+// A literal gets just enough limbs for its digits. Mixed capacities meet at the larger one, and
+// ConstBigInteger<M>(value) makes room for a product: ConstBigInteger<8>(first) * second.
+template <size_t N>
+class ConstBigInteger {
+private:
+    template <size_t M>
+    friend class ConstBigInteger;
+
+    static constexpr int kBase = 1000000000;
+
+    int array[N] = {};
+    size_t length = 0;
+    bool positive = true;
+
+    constexpr void change_length() {
+      length = N;
+      while (length > 0 and array[length - 1] == 0) {
+        --length;
+      }
+      if (length == 0) {
+        positive = true;
+      }
+    }
+    constexpr int compare_magnitude(const ConstBigInteger& other) const;
+    constexpr void add_magnitude(const ConstBigInteger& other);
+    constexpr void subtract_magnitude(const ConstBigInteger& other);
+public:
+    constexpr ConstBigInteger() = default;
+    constexpr ConstBigInteger(long long number);
+    constexpr explicit ConstBigInteger(std::string_view string);
+    // Widening is implicit; narrowing is explicit and throws if the value does not fit.
+    template <size_t M>
+    constexpr explicit(M > N) ConstBigInteger(const ConstBigInteger<M>& other);
+
+    constexpr int sign() const {
+      return length == 0 ? 0 : (positive ? 1 : -1);
+    }
+    constexpr size_t limbs() const {
+      return length;
+    }
+
+    constexpr bool operator==(const ConstBigInteger& other) const {
+      return sign() == other.sign() and compare_magnitude(other) == 0;
+    }
+    constexpr bool operator!=(const ConstBigInteger& other) const {
+      return !(*this == other);
+    }
+    constexpr bool operator<(const ConstBigInteger& other) const;
+    constexpr bool operator>(const ConstBigInteger& other) const {
+      return other < *this;
+    }
+    constexpr bool operator<=(const ConstBigInteger& other) const {
+      return !(other < *this);
+    }
+    constexpr bool operator>=(const ConstBigInteger& other) const {
+      return !(*this < other);
+    }
+
+    constexpr ConstBigInteger operator-() const {
+      ConstBigInteger result(*this);
+      result.positive = !positive or length == 0;
+      return result;
+    }
+    constexpr ConstBigInteger& operator+=(const ConstBigInteger& other);
+    constexpr ConstBigInteger& operator-=(const ConstBigInteger& other) {
+      return *this += -other;
+    }
+    constexpr ConstBigInteger& operator*=(const ConstBigInteger& other);
+    constexpr ConstBigInteger operator+(const ConstBigInteger& second) const {
+      ConstBigInteger result(*this);
+      result += second;
+      return result;
+    }
+    constexpr ConstBigInteger operator-(const ConstBigInteger& second) const {
+      ConstBigInteger result(*this);
+      result -= second;
+      return result;
+    }
+    constexpr ConstBigInteger operator*(const ConstBigInteger& second) const {
+      ConstBigInteger result(*this);
+      result *= second;
+      return result;
+    }
+
+    operator BigInteger() const;
+};
+
+template <size_t N>
+constexpr ConstBigInteger<N>::ConstBigInteger(long long number): positive(number >= 0) {
+  unsigned long long magnitude = number < 0 ? 0ULL - static_cast<unsigned long long>(number) : number;
+  for (; magnitude != 0; magnitude /= kBase) {
+    if (length == N) {
+      throw std::overflow_error("ConstBigInteger capacity exceeded");
+    }
+    array[length++] = static_cast<int>(magnitude % kBase);
+  }
+}
+
+template <size_t N>
+constexpr ConstBigInteger<N>::ConstBigInteger(std::string_view string) {
+  size_t begin = 0;
+  if (!string.empty() and string[0] == '-') {
+    positive = false;
+    begin = 1;
+  }
+  int block = 0;
+  int multiplier = 1;
+  size_t index = 0;
+  for (size_t i = string.size(); i > begin; --i) {
+    if (string[i - 1] != '\'') {
+      block += (string[i - 1] - '0') * multiplier;
+      multiplier *= 10;
+    }
+    if (multiplier == kBase or (i - 1 == begin and multiplier != 1)) {
+      if (index == N) {
+        throw std::overflow_error("ConstBigInteger capacity exceeded");
+      }
+      array[index++] = block;
+      block = 0;
+      multiplier = 1;
+    }
+  }
+  change_length();
+}
+
+template <size_t N>
+template <size_t M>
+constexpr ConstBigInteger<N>::ConstBigInteger(const ConstBigInteger<M>& other):
+        length(other.length), positive(other.positive) {
+  if (other.length > N) {
+    throw std::overflow_error("ConstBigInteger capacity exceeded");
+  }
+  for (size_t i = 0; i < other.length; ++i) {
+    array[i] = other.array[i];
+  }
+}
+
+template <size_t N>
+constexpr int ConstBigInteger<N>::compare_magnitude(const ConstBigInteger& other) const {
+  if (length != other.length) {
+    return length < other.length ? -1 : 1;
+  }
+  for (size_t i = length; i > 0; --i) {
+    if (array[i - 1] != other.array[i - 1]) {
+      return array[i - 1] < other.array[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+template <size_t N>
+constexpr bool ConstBigInteger<N>::operator<(const ConstBigInteger& other) const {
+  if (sign() != other.sign()) {
+    return sign() < other.sign();
+  }
+  int magnitude = compare_magnitude(other);
+  return positive ? magnitude < 0 : magnitude > 0;
+}
+
+template <size_t N>
+constexpr void ConstBigInteger<N>::add_magnitude(const ConstBigInteger& other) {
+  int carry = 0;
+  for (size_t i = 0; i < std::max(length, other.length) or carry != 0; ++i) {
+    if (i == N) {
+      throw std::overflow_error("ConstBigInteger capacity exceeded");
+    }
+    int sum = array[i] + other.array[i] + carry;
+    carry = sum >= kBase ? 1 : 0;
+    array[i] = sum - carry * kBase;
+  }
+  change_length();
+}
+
+// Requires |*this| >= |other|.
+template <size_t N>
+constexpr void ConstBigInteger<N>::subtract_magnitude(const ConstBigInteger& other) {
+  int borrow = 0;
+  for (size_t i = 0; i < length; ++i) {
+    int difference = array[i] - other.array[i] - borrow;
+    borrow = difference < 0 ? 1 : 0;
+    array[i] = difference + borrow * kBase;
+  }
+  change_length();
+}
+
+template <size_t N>
+constexpr ConstBigInteger<N>& ConstBigInteger<N>::operator+=(const ConstBigInteger& other) {
+  if (positive == other.positive or other.length == 0) {
+    add_magnitude(other);
+  } else if (compare_magnitude(other) >= 0) {
+    subtract_magnitude(other);
+  } else {
+    ConstBigInteger result(other);
+    result.subtract_magnitude(*this);
+    *this = result;
+  }
+  return *this;
+}
+
+template <size_t N>
+constexpr ConstBigInteger<N>& ConstBigInteger<N>::operator*=(const ConstBigInteger& other) {
+  if (length == 0 or other.length == 0) {
+    *this = ConstBigInteger();
+    return *this;
+  }
+  if (length + other.length - 1 > N) {
+    throw std::overflow_error("ConstBigInteger capacity exceeded");
+  }
+  unsigned long long result[N + 1] = {};
+  for (size_t i = 0; i < length; ++i) {
+    unsigned long long carry = 0;
+    for (size_t j = 0; j < other.length and i + j < N; ++j) {
+      unsigned long long current = static_cast<unsigned long long>(array[i]) * other.array[j] + result[i + j] + carry;
+      result[i + j] = current % kBase;
+      carry = current / kBase;
+    }
+    result[std::min(i + other.length, N)] += carry;
+  }
+  if (result[N] != 0) {
+    throw std::overflow_error("ConstBigInteger capacity exceeded");
+  }
+  for (size_t i = 0; i < N; ++i) {
+    array[i] = static_cast<int>(result[i]);
+  }
+  positive = positive == other.positive;
+  change_length();
+  return *this;
+}
+
+template <size_t N>
+ConstBigInteger<N>::operator BigInteger() const {
+  BigInteger result;
+  result.array.assign(array, array + std::max<size_t>(length, 1));
+  result.length = length;
+  result.positive = positive;
+  return result;
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr ConstBigInteger<std::max(N, M)> operator+(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return ConstBigInteger<std::max(N, M)>(first) + ConstBigInteger<std::max(N, M)>(second);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr ConstBigInteger<std::max(N, M)> operator-(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return ConstBigInteger<std::max(N, M)>(first) - ConstBigInteger<std::max(N, M)>(second);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr ConstBigInteger<std::max(N, M)> operator*(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return ConstBigInteger<std::max(N, M)>(first) * ConstBigInteger<std::max(N, M)>(second);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr bool operator==(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return ConstBigInteger<std::max(N, M)>(first) == ConstBigInteger<std::max(N, M)>(second);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr bool operator<(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return ConstBigInteger<std::max(N, M)>(first) < ConstBigInteger<std::max(N, M)>(second);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr bool operator>(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return second < first;
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr bool operator<=(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return !(second < first);
+}
+
+template <size_t N, size_t M> requires (N != M)
+constexpr bool operator>=(const ConstBigInteger<N>& first, const ConstBigInteger<M>& second) {
+  return !(first < second);
+}
+
+template <char... Digits>
+constexpr ConstBigInteger<(sizeof...(Digits) + 8) / 9> operator""_cbi() {
+  constexpr char digits[] = {Digits..., '\0'};
+  return ConstBigInteger<(sizeof...(Digits) + 8) / 9>(digits);
+}
+
+template <size_t Count, size_t N>
+constexpr std::array<ConstBigInteger<N>, Count> powerTable(const ConstBigInteger<N>& base) {
+  std::array<ConstBigInteger<N>, Count> table{};
+  for (size_t i = 0; i < Count; ++i) {
+    table[i] = i == 0 ? ConstBigInteger<N>(1) : table[i - 1] * base;
+  }
+  return table;
+}
+
+// Fixed-width two's complement integer on Bits / 64 stack limbs; arithmetic wraps modulo 2^Bits.
+template <size_t Bits>
+class WideInt {
+    static_assert(Bits % 64 == 0 and Bits >= 64, "WideInt width must be a positive multiple of 64");
+private:
+    static constexpr size_t kLimbs = Bits / 64;
+
+    uint64_t limbs[kLimbs] = {};
+
+    constexpr bool negative() const {
+      return (limbs[kLimbs - 1] >> 63) != 0;
+    }
+    constexpr WideInt magnitude() const {
+      return negative() ? -*this : *this;
+    }
+    constexpr int compare_unsigned(const WideInt& other) const;
+    constexpr uint64_t divide_small(uint64_t divisor);
+    static constexpr void divide_unsigned(const WideInt& dividend, const WideInt& divisor,
+                                          WideInt& quotient, WideInt& remainder);
+public:
+    constexpr WideInt() = default;
+    constexpr WideInt(long long number);
+    explicit WideInt(const std::string& string);
+    explicit WideInt(const BigInteger& number);
+
+    explicit constexpr operator bool() const {
+      for (size_t i = 0; i < kLimbs; ++i) {
+        if (limbs[i] != 0) {
+          return true;
+        }
+      }
+      return false;
+    }
+    operator BigInteger() const;
+
+    constexpr bool operator==(const WideInt& other) const {
+      return compare_unsigned(other) == 0;
+    }
+    constexpr bool operator!=(const WideInt& other) const {
+      return !(*this == other);
+    }
+    constexpr bool operator<(const WideInt& other) const {
+      if (negative() != other.negative()) {
+        return negative();
+      }
+      return compare_unsigned(other) < 0;
+    }
+    constexpr bool operator>(const WideInt& other) const {
+      return other < *this;
+    }
+    constexpr bool operator>=(const WideInt& other) const {
+      return !(*this < other);
+    }
+    constexpr bool operator<=(const WideInt& other) const {
+      return !(other < *this);
+    }
+
+    constexpr WideInt& operator+=(const WideInt& other);
+    constexpr WideInt& operator-=(const WideInt& other);
+    constexpr WideInt& operator*=(const WideInt& other);
+    constexpr WideInt& operator/=(const WideInt& other);
+    constexpr WideInt& operator%=(const WideInt& other);
+
+    constexpr WideInt operator+(const WideInt& second) const {
+      WideInt result(*this);
+      return result += second;
+    }
+    constexpr WideInt operator-(const WideInt& second) const {
+      WideInt result(*this);
+      return result -= second;
+    }
+    constexpr WideInt operator*(const WideInt& second) const {
+      WideInt result(*this);
+      return result *= second;
+    }
+    constexpr WideInt operator/(const WideInt& second) const {
+      WideInt result(*this);
+      return result /= second;
+    }
+    constexpr WideInt operator%(const WideInt& second) const {
+      WideInt result(*this);
+      return result %= second;
+    }
+
+    constexpr WideInt operator-() const;
+    constexpr WideInt& operator++() {
+      return *this += 1;
+    }
+    constexpr WideInt& operator--() {
+      return *this -= 1;
+    }
+    constexpr WideInt operator++(int) {
+      WideInt result(*this);
+      *this += 1;
+      return result;
+    }
+    constexpr WideInt operator--(int) {
+      WideInt result(*this);
+      *this -= 1;
+      return result;
+    }
+
+    std::string toString() const;
+};
+
+template <size_t Bits>
+constexpr WideInt<Bits>::WideInt(long long number) {
+  limbs[0] = static_cast<uint64_t>(number);
+  for (size_t i = 1; i < kLimbs; ++i) {
+    limbs[i] = number < 0 ? ~0ULL : 0;
+  }
+}
+
+template <size_t Bits>
+WideInt<Bits>::WideInt(const std::string& string) {
+  size_t begin = !string.empty() and string[0] == '-' ? 1 : 0;
+  for (size_t i = begin; i < string.size(); i += 18) {
+    size_t digits = std::min<size_t>(18, string.size() - i);
+    uint64_t scale = 1;
+    for (size_t j = 0; j < digits; ++j) {
+      scale *= 10;
+    }
+    *this *= WideInt(static_cast<long long>(scale));
+    *this += WideInt(std::stoll(string.substr(i, digits)));
+  }
+  if (begin == 1) {
+    *this = -*this;
+  }
+}
+
+template <size_t Bits>
+WideInt<Bits>::WideInt(const BigInteger& number) {
+  const WideInt base(BigInteger::kBase);
+  for (size_t i = number.length; i > 0; --i) {
+    *this *= base;
+    *this += WideInt(number.array[i - 1]);
+  }
+  if (number.sign() < 0) {
+    *this = -*this;
+  }
+}
+
+template <size_t Bits>
+WideInt<Bits>::operator BigInteger() const {
+  WideInt rest = magnitude();
+  BigInteger result;
+  result.array.clear();
+  while (static_cast<bool>(rest)) {
+    result.array.push_back(static_cast<int>(rest.divide_small(BigInteger::kBase)));
+  }
+  if (result.array.empty()) {
+    result.array.push_back(0);
+  }
+  result.change_length();
+  result.positive = !negative() or result.length == 0;
+  return result;
+}
+
+template <size_t Bits>
+constexpr int WideInt<Bits>::compare_unsigned(const WideInt& other) const {
+  for (size_t i = kLimbs; i > 0; --i) {
+    if (limbs[i - 1] != other.limbs[i - 1]) {
+      return limbs[i - 1] < other.limbs[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits>& WideInt<Bits>::operator+=(const WideInt& other) {
+  unsigned __int128 carry = 0;
+  for (size_t i = 0; i < kLimbs; ++i) {
+    carry += static_cast<unsigned __int128>(limbs[i]) + other.limbs[i];
+    limbs[i] = static_cast<uint64_t>(carry);
+    carry >>= 64;
+  }
+  return *this;
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits>& WideInt<Bits>::operator-=(const WideInt& other) {
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < kLimbs; ++i) {
+    uint64_t subtrahend = other.limbs[i] + borrow;
+    uint64_t next_borrow = (subtrahend < borrow) or (limbs[i] < subtrahend) ? 1 : 0;
+    limbs[i] -= subtrahend;
+    borrow = next_borrow;
+  }
+  return *this;
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits>& WideInt<Bits>::operator*=(const WideInt& other) {
+  uint64_t result[kLimbs] = {};
+  for (size_t i = 0; i < kLimbs; ++i) {
+    unsigned __int128 carry = 0;
+    for (size_t j = 0; i + j < kLimbs; ++j) {
+      carry += static_cast<unsigned __int128>(limbs[i]) * other.limbs[j] + result[i + j];
+      result[i + j] = static_cast<uint64_t>(carry);
+      carry >>= 64;
+    }
+  }
+  for (size_t i = 0; i < kLimbs; ++i) {
+    limbs[i] = result[i];
+  }
+  return *this;
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits> WideInt<Bits>::operator-() const {
+  WideInt result;
+  for (size_t i = 0; i < kLimbs; ++i) {
+    result.limbs[i] = ~limbs[i];
+  }
+  return result += 1;
+}
+
+// Unsigned in-place division by a single limb, returns the remainder.
+template <size_t Bits>
+constexpr uint64_t WideInt<Bits>::divide_small(uint64_t divisor) {
+  unsigned __int128 remainder = 0;
+  for (size_t i = kLimbs; i > 0; --i) {
+    remainder = (remainder << 64) | limbs[i - 1];
+    limbs[i - 1] = static_cast<uint64_t>(remainder / divisor);
+    remainder %= divisor;
+  }
+  return static_cast<uint64_t>(remainder);
+}
+
+template <size_t Bits>
+constexpr void WideInt<Bits>::divide_unsigned(const WideInt& dividend, const WideInt& divisor,
+                                              WideInt& quotient, WideInt& remainder) {
+  quotient = WideInt();
+  remainder = WideInt();
+  size_t divisor_limbs = kLimbs;
+  while (divisor_limbs > 0 and divisor.limbs[divisor_limbs - 1] == 0) {
+    --divisor_limbs;
+  }
+  if (divisor_limbs == 1) {
+    quotient = dividend;
+    remainder.limbs[0] = quotient.divide_small(divisor.limbs[0]);
+    return;
+  }
+  for (size_t bit = Bits; bit > 0; --bit) {
+    for (size_t i = kLimbs - 1; i > 0; --i) {
+      remainder.limbs[i] = (remainder.limbs[i] << 1) | (remainder.limbs[i - 1] >> 63);
+    }
+    remainder.limbs[0] = (remainder.limbs[0] << 1) | ((dividend.limbs[(bit - 1) / 64] >> ((bit - 1) % 64)) & 1);
+    if (remainder.compare_unsigned(divisor) >= 0) {
+      remainder -= divisor;
+      quotient.limbs[(bit - 1) / 64] |= 1ULL << ((bit - 1) % 64);
+    }
+  }
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits>& WideInt<Bits>::operator/=(const WideInt& other) {
+  bool result_negative = negative() != other.negative();
+  WideInt quotient;
+  WideInt remainder;
+  divide_unsigned(magnitude(), other.magnitude(), quotient, remainder);
+  *this = result_negative ? -quotient : quotient;
+  return *this;
+}
+
+template <size_t Bits>
+constexpr WideInt<Bits>& WideInt<Bits>::operator%=(const WideInt& other) {
+  bool result_negative = negative();
+  WideInt quotient;
+  WideInt remainder;
+  divide_unsigned(magnitude(), other.magnitude(), quotient, remainder);
+  *this = result_negative ? -remainder : remainder;
+  return *this;
+}
+
+template <size_t Bits>
+std::string WideInt<Bits>::toString() const {
+  WideInt rest = magnitude();
+  std::string result;
+  do {
+    std::string block = std::to_string(rest.divide_small(10000000000000000000ULL));
+    if (static_cast<bool>(rest)) {
+      block.insert(0, 19 - block.size(), '0');
+    }
+    result.insert(0, block);
+  } while (static_cast<bool>(rest));
+  if (negative()) {
+    result.insert(0, "-");
+  }
+  return result;
+}
+
+template <size_t Bits>
+std::ostream& operator<<(std::ostream& out, const WideInt<Bits>& number) {
+  out << number.toString();
+  return out;
+}
+
+template <size_t Bits>
+std::istream& operator>>(std::istream& in, WideInt<Bits>& number) {
+  std::string string;
+  in >> string;
+  number = WideInt<Bits>(string);
+  return in;
+}
+
+// Many independent BigIntegers stored limb-major: limbs[limb * count + lane]. Lanes are kept in
+// base-1e9 complement form (negative x is kBase^width - |x|) with a pure sign limb on top, so add,
+// sub, multiply-by-small and compare run the same carry loop on every lane and the inner loops
+// over lanes are left to the compiler's vectorizer. Batches whose lane lengths differ too much
+// keep plain BigIntegers and fall back to per-element arithmetic.
+class BigIntegerBatch {
+private:
+    static constexpr int kBase = BigInteger::kBase;
+
+    size_t count = 0;
+    size_t width = 0;
+    std::vector<int> limbs;
+    std::vector<BigInteger> scattered;
+    bool packed = true;
+
+    void widen(size_t new_width);
+    void fit();
+    void check_count(const BigIntegerBatch& other) const;
+    void negate_lanes(const std::vector<char>& lanes);
+    void unpack();
+public:
+    BigIntegerBatch() = default;
+    explicit BigIntegerBatch(const std::vector<BigInteger>& numbers);
+
+    size_t size() const {
+      return count;
+    }
+    bool isPacked() const {
+      return packed;
+    }
+    BigInteger get(size_t lane) const;
+    std::vector<BigInteger> toVector() const;
+
+    BigIntegerBatch& operator+=(const BigIntegerBatch& other);
+    BigIntegerBatch& operator-=(const BigIntegerBatch& other);
+    BigIntegerBatch& operator*=(int factor);
+    std::vector<int> compare(const BigIntegerBatch& other) const;
+};
+
+BigIntegerBatch::BigIntegerBatch(const std::vector<BigInteger>& numbers): count(numbers.size()) {
+  size_t longest = 0;
+  size_t total = 0;
+  for (const auto& number : numbers) {
+    longest = std::max(longest, number.length);
+    total += number.length;
+  }
+  if (count != 0 and longest > 2 * (total / count) + 2) {
+    packed = false;
+    scattered = numbers;
+    return;
+  }
+  width = longest + 1;
+  limbs.assign(width * count, 0);
+  std::vector<char> negative(count, 0);
+  for (size_t lane = 0; lane < count; ++lane) {
+    const BigInteger& number = numbers[lane];
+    for (size_t i = 0; i < number.length; ++i) {
+      limbs[i * count + lane] = number.array[i];
+    }
+    negative[lane] = number.sign() < 0;
+  }
+  negate_lanes(negative);
+}
+
+void BigIntegerBatch::widen(size_t new_width) {
+  limbs.resize(new_width * count);
+  for (size_t i = width; i < new_width; ++i) {
+    for (size_t lane = 0; lane < count; ++lane) {
+      limbs[i * count + lane] = limbs[(width - 1) * count + lane] >= kBase / 2 ? kBase - 1 : 0;
+    }
+  }
+  width = new_width;
+}
+
+// Restores a pure sign limb on top: adds one after an overflow, drops the ones left redundant.
+void BigIntegerBatch::fit() {
+  const int* top = limbs.data() + (width - 1) * count;
+  bool overflow = false;
+  for (size_t lane = 0; lane < count; ++lane) {
+    overflow |= top[lane] != 0 and top[lane] != kBase - 1;
+  }
+  if (overflow) {
+    widen(width + 1);
+    return;
+  }
+  while (width > 2) {
+    const int* below = limbs.data() + (width - 2) * count;
+    top = below + count;
+    bool redundant = true;
+    for (size_t lane = 0; lane < count; ++lane) {
+      redundant &= below[lane] == top[lane];
+    }
+    if (!redundant) {
+      break;
+    }
+    --width;
+    limbs.resize(width * count);
+  }
+}
+
+void BigIntegerBatch::check_count(const BigIntegerBatch& other) const {
+  if (count != other.count) {
+    throw std::invalid_argument("BigIntegerBatch sizes do not match");
+  }
+}
+
+void BigIntegerBatch::negate_lanes(const std::vector<char>& lanes) {
+  std::vector<int> carry(lanes.begin(), lanes.end());
+  for (size_t i = 0; i < width; ++i) {
+    int* row = limbs.data() + i * count;
+    for (size_t lane = 0; lane < count; ++lane) {
+      int value = lanes[lane] ? kBase - 1 - row[lane] + carry[lane] : row[lane];
+      carry[lane] = value == kBase;
+      row[lane] = value == kBase ? 0 : value;
+    }
+  }
+}
+
+void BigIntegerBatch::unpack() {
+  if (packed) {
+    scattered = toVector();
+    limbs.clear();
+    width = 0;
+    packed = false;
+  }
+}
+
+BigInteger BigIntegerBatch::get(size_t lane) const {
+  if (!packed) {
+    return scattered[lane];
+  }
+  BigInteger result;
+  result.array.assign(width, 0);
+  bool negative = limbs[(width - 1) * count + lane] >= kBase / 2;
+  int carry = negative ? 1 : 0;
+  for (size_t i = 0; i < width; ++i) {
+    int value = limbs[i * count + lane];
+    if (negative) {
+      value = kBase - 1 - value + carry;
+      carry = value == kBase;
+      value = value == kBase ? 0 : value;
+    }
+    result.array[i] = value;
+  }
+  result.change_length();
+  result.positive = !negative or result.length == 0;
+  return result;
+}
+
+std::vector<BigInteger> BigIntegerBatch::toVector() const {
+  if (!packed) {
+    return scattered;
+  }
+  std::vector<BigInteger> result;
+  result.reserve(count);
+  for (size_t lane = 0; lane < count; ++lane) {
+    result.push_back(get(lane));
+  }
+  return result;
+}
+
+BigIntegerBatch& BigIntegerBatch::operator+=(const BigIntegerBatch& other) {
+  check_count(other);
+  if (!packed or !other.packed) {
+    unpack();
+    std::vector<BigInteger> others = other.toVector();
+    for (size_t lane = 0; lane < count; ++lane) {
+      scattered[lane] += others[lane];
+    }
+    return *this;
+  }
+  if (width < other.width) {
+    widen(other.width);
+  }
+  std::vector<int> carry(count, 0);
+  for (size_t i = 0; i < width; ++i) {
+    int* row = limbs.data() + i * count;
+    size_t other_row = std::min(i, other.width - 1) * other.count;
+    for (size_t lane = 0; lane < count; ++lane) {
+      int addend = other.limbs[other_row + lane];
+      if (i >= other.width) {
+        addend = addend >= kBase / 2 ? kBase - 1 : 0;
+      }
+      int sum = row[lane] + addend + carry[lane];
+      carry[lane] = sum >= kBase;
+      row[lane] = sum >= kBase ? sum - kBase : sum;
+    }
+  }
+  fit();
+  return *this;
+}
+
+BigIntegerBatch& BigIntegerBatch::operator-=(const BigIntegerBatch& other) {
+  check_count(other);
+  if (!packed or !other.packed) {
+    unpack();
+    std::vector<BigInteger> others = other.toVector();
+    for (size_t lane = 0; lane < count; ++lane) {
+      scattered[lane] -= others[lane];
+    }
+    return *this;
+  }
+  if (width < other.width) {
+    widen(other.width);
+  }
+  std::vector<int> borrow(count, 0);
+  for (size_t i = 0; i < width; ++i) {
+    int* row = limbs.data() + i * count;
+    size_t other_row = std::min(i, other.width - 1) * other.count;
+    for (size_t lane = 0; lane < count; ++lane) {
+      int subtrahend = other.limbs[other_row + lane];
+      if (i >= other.width) {
+        subtrahend = subtrahend >= kBase / 2 ? kBase - 1 : 0;
+      }
+      int difference = row[lane] - subtrahend - borrow[lane];
+      borrow[lane] = difference < 0;
+      row[lane] = difference < 0 ? difference + kBase : difference;
+    }
+  }
+  fit();
+  return *this;
+}
+
+BigIntegerBatch& BigIntegerBatch::operator*=(int factor) {
+  if (!packed) {
+    for (auto& number : scattered) {
+      number *= factor;
+    }
+    return *this;
+  }
+  std::vector<char> negative(count);
+  for (size_t lane = 0; lane < count; ++lane) {
+    negative[lane] = limbs[(width - 1) * count + lane] >= kBase / 2;
+  }
+  negate_lanes(negative);
+  auto magnitude = static_cast<long long>(factor < 0 ? -static_cast<long long>(factor) : factor);
+  // A magnitude below (highest + 1) * kBase^(width - 2) keeps its product under the sign limb
+  // unless that times the factor reaches kBase; only -kBase^(width - 1) reaches the sign limb.
+  if (width >= 2) {
+    const int* highest = limbs.data() + (width - 2) * count;
+    const int* top = highest + count;
+    bool overflow = false;
+    for (size_t lane = 0; lane < count; ++lane) {
+      overflow |= top[lane] != 0 or (highest[lane] + 1LL) * magnitude >= kBase;
+    }
+    if (overflow) {
+      widen(width + (magnitude >= kBase ? 2 : 1));
+    }
+  }
+  std::vector<long long> carry(count, 0);
+  for (size_t i = 0; i < width; ++i) {
+    int* row = limbs.data() + i * count;
+    for (size_t lane = 0; lane < count; ++lane) {
+      long long product = row[lane] * magnitude + carry[lane];
+      carry[lane] = product / kBase;
+      row[lane] = static_cast<int>(product - carry[lane] * kBase);
+    }
+  }
+  if (factor < 0) {
+    for (auto& lane : negative) {
+      lane = !lane;
+    }
+  }
+  negate_lanes(negative);
+  fit();
+  return *this;
+}
+
+std::vector<int> BigIntegerBatch::compare(const BigIntegerBatch& other) const {
+  check_count(other);
+  std::vector<int> result(count);
+  if (!packed or !other.packed) {
+    std::vector<BigInteger> first = toVector();
+    std::vector<BigInteger> second = other.toVector();
+    for (size_t lane = 0; lane < count; ++lane) {
+      result[lane] = first[lane] < second[lane] ? -1 : (second[lane] < first[lane] ? 1 : 0);
+    }
+    return result;
+  }
+  size_t common = std::max(width, other.width) + 1;
+  std::vector<int> borrow(count, 0);
+  std::vector<char> nonzero(count, 0);
+  std::vector<int> top(count, 0);
+  for (size_t i = 0; i < common; ++i) {
+    const int* row = limbs.data() + std::min(i, width - 1) * count;
+    const int* other_row = other.limbs.data() + std::min(i, other.width - 1) * other.count;
+    for (size_t lane = 0; lane < count; ++lane) {
+      int minuend = row[lane];
+      if (i >= width) {
+        minuend = minuend >= kBase / 2 ? kBase - 1 : 0;
+      }
+      int subtrahend = other_row[lane];
+      if (i >= other.width) {
+        subtrahend = subtrahend >= kBase / 2 ? kBase - 1 : 0;
+      }
+      int difference = minuend - subtrahend - borrow[lane];
+      borrow[lane] = difference < 0;
+      difference = difference < 0 ? difference + kBase : difference;
+      nonzero[lane] |= difference != 0;
+      top[lane] = difference;
+    }
+  }
+  for (size_t lane = 0; lane < count; ++lane) {
+    result[lane] = top[lane] >= kBase / 2 ? -1 : (nonzero[lane] ? 1 : 0);
+  }
+  return result;
+}
+
+// BigIntegers constructed while an arena is alive take their limbs from it and must not outlive it.
+template <size_t N = 4096>
+class BigIntegerArena {
+    alignas(std::max_align_t) char memory[N];
+    std::pmr::monotonic_buffer_resource resource;
+    std::pmr::memory_resource* previous;
+public:
+    BigIntegerArena(): resource(memory, N), previous(BigInteger::setMemoryResource(&resource)) {}
+
+    BigIntegerArena(const BigIntegerArena&) = delete;
+    BigIntegerArena& operator=(const BigIntegerArena&) = delete;
+
+    ~BigIntegerArena() {
+      BigInteger::setMemoryResource(previous);
+    }
+};
+
+class Rational {
+private:
+    BigInteger numerator = 0;
+    BigInteger denominator = 1;
+    mutable double approximation = 0;
+    mutable long long approximation_shift = 0;
+    mutable bool approximated = false;
+    mutable size_t hash_value = 0;
+    mutable bool hashed = false;
+
+    void reduction();
+    void invalidate();
+    void approximate() const;
+    int compare(const Rational& other) const;
+
+    friend class Convergents;
+    friend class Decimal;
+public:
+    Rational() {}
+    Rational(long long number);
+    Rational(BigInteger number) {
+      numerator = number;
+      denominator = 1;
+    }
+    template <std::floating_point Float>
+    explicit Rational(Float value);
+    Rational(const Rational& other) = default;
+
+    Rational& operator=(const Rational& other) = default;
+
+    Rational operator-() const;
+
+    Rational& operator+=(const Rational& other);
+    Rational& operator-=(const Rational& other);
+    Rational& operator*=(const Rational& other);
+    Rational& operator/=(const Rational& other);
+
+    Rational operator+(const Rational& second) const;
+    Rational operator-(const Rational& second) const;
+    Rational operator*(const Rational& second) const;
+    Rational operator/(const Rational& second) const;
+
+    bool operator==(const Rational& other) const {
+      return compare(other) == 0;
+    }
+    bool operator!=(const Rational& other) const {
+      return !(*this == other);
+    }
+    bool operator<(const Rational& other) const {
+      return compare(other) < 0;
+    }
+    bool operator>(const Rational& other) const {
+      return compare(other) > 0;
+    }
+    bool operator>=(const Rational& other) const {
+      return compare(other) >= 0;
+    }
+    bool operator<=(const Rational& other) const {
+      return compare(other) <= 0;
+    }
+
+    Rational limitDenominator(const BigInteger& max_denominator) const;
+
+    std::string asDecimal(size_t precision = 0) const;
+    void writeDecimal(std::ostream& out, size_t precision) const;
+    std::string toString();
+    size_t hash() const;
+    void writeBinary(std::string& out) const;
+    const char* readBinary(const char* begin, const char* end);
+
+    explicit operator double() const;
+};
+
+void Rational::reduction() {
+  BigInteger divisor = gcd(numerator, denominator);
+  if (divisor.sign() != 0 and divisor != 1) {
+    numerator /= divisor;
+    denominator /= divisor;
+  }
+}
+
+void Rational::invalidate() {
+  approximated = false;
+  hashed = false;
+}
+
+// Hash of the reduced form, cached until the value changes; integers skip the gcd.
+size_t Rational::hash() const {
+  if (!hashed) {
+    BigInteger divisor = denominator == 1 ? BigInteger(1) : gcd(numerator, denominator);
+    if (divisor == 1) {
+      hash_value = numerator.hash() * 31 + denominator.hash();
+    } else {
+      hash_value = (numerator / divisor).hash() * 31 + (denominator / divisor).hash();
+    }
+    hashed = true;
+  }
+  return hash_value;
+}
+
+void Rational::approximate() const {
+  size_t numerator_shift;
+  size_t denominator_shift;
+  double numerator_top = numerator.approximate(numerator_shift);
+  double denominator_top = denominator.approximate(denominator_shift);
+  approximation = numerator_top / denominator_top;
+  approximation_shift = static_cast<long long>(numerator_shift) - static_cast<long long>(denominator_shift);
+  approximated = true;
+}
+
+int Rational::compare(const Rational& other) const {
+  int sign = numerator.sign();
+  int other_sign = other.numerator.sign();
+  if (sign != other_sign) {
+    return sign < other_sign ? -1 : 1;
+  }
+  if (sign == 0) {
+    return 0;
+  }
+  // |numerator * other.denominator| has limbs() or limbs() - 1 limbs.
+  size_t length = numerator.limbs() + other.denominator.limbs();
+  size_t other_length = other.numerator.limbs() + denominator.limbs();
+  if (length > other_length + 1) {
+    return sign;
+  }
+  if (other_length > length + 1) {
+    return -sign;
+  }
+  if (!approximated) {
+    approximate();
+  }
+  if (!other.approximated) {
+    other.approximate();
+  }
+  double ratio = approximation / other.approximation *
+                 std::pow(1e9, static_cast<double>(approximation_shift - other.approximation_shift));
+  if (ratio > 1 + 1e-12) {
+    return sign;
+  }
+  if (ratio < 1 - 1e-12) {
+    return -sign;
+  }
+  BigIntegerArena<> arena;
+  BigInteger first = numerator * other.denominator;
+  BigInteger second = other.numerator * denominator;
+  if (first < second) {
+    return -1;
+  }
+  return second < first ? 1 : 0;
+}
+
+Rational::Rational(long long int number) {
+  BigInteger new_number(number);
+  numerator = new_number;
+  denominator = 1;
+}
 
-Rational Rational::operator-() {
+Rational Rational::operator-() const {
   Rational rational(*this);
   rational.numerator = -rational.numerator;
+  rational.invalidate();
   return rational;
 }
 
 Rational &Rational::operator+=(const Rational &other) {
+  BigIntegerArena<> arena;
   BigInteger new_numerator = numerator * other.denominator + other.numerator * denominator;
   BigInteger new_denomirnator = denominator * other.denominator;
   numerator = new_numerator;
   denominator = new_denomirnator;
+  invalidate();
   return *this;
 }
 
 Rational &Rational::operator-=(const Rational &other) {
+  BigIntegerArena<> arena;
   BigInteger new_numerator = numerator * other.denominator - other.numerator * denominator;
   BigInteger new_denomirnator = denominator * other.denominator;
   numerator = new_numerator;
   denominator = new_denomirnator;
+  invalidate();
   return *this;
 }
 
 Rational &Rational::operator*=(const Rational &other) {
+  BigIntegerArena<> arena;
   BigInteger new_numerator = numerator * other.numerator;
   BigInteger new_denomirnator = denominator * other.denominator;
   numerator = new_numerator;
   denominator = new_denomirnator;
+  invalidate();
   return *this;
 }
 
 Rational &Rational::operator/=(const Rational &other) {
+  BigIntegerArena<> arena;
   BigInteger new_numerator = numerator * other.denominator;
   BigInteger new_denomirnator = denominator * other.numerator;
   if (new_denomirnator < 0) {
@@ -646,6 +2614,7 @@ Rational &Rational::operator/=(const Rational &other) {
   }
   numerator = new_numerator;
   denominator = new_denomirnator;
+  invalidate();
   return *this;
 }
 
@@ -673,73 +2642,237 @@ Rational Rational::operator/(const Rational &second) const {
   return result;
 }
 
-bool Rational::operator<(const Rational &other) const {
-  if (numerator > 0 and other.numerator < 0) {
-    return false;
+std::string Rational::asDecimal(size_t precision) const {
+  BigInteger scaled = numerator * power(10, precision);
+  scaled /= denominator;
+  std::string string = scaled.toString();
+  bool negative = string[0] == '-';
+  if (negative) {
+    string.erase(0, 1);
   }
-  if (numerator < 0 and other.numerator > 0) {
-    return true;
+  if (precision != 0) {
+    if (string.size() <= precision) {
+      string.insert(0, precision + 1 - string.size(), '0');
+    }
+    string.insert(string.size() - precision, ".");
   }
-  return numerator * other.denominator < other.numerator * denominator;
+  if (negative) {
+    string.insert(0, "-");
+  }
+  return string;
 }
 
-std::string Rational::asDecimal(size_t precision) const {
-  BigInteger base(1e9);
-  BigInteger ten(10);
-  BigInteger rounded_mantissa(numerator);
-  BigInteger new_numerator(numerator);
-  for (size_t i = 0; i < precision; ++i) {
-    new_numerator *= base;
-    rounded_mantissa *= ten;
+void Rational::writeDecimal(std::ostream& out, size_t precision) const {
+  bool negative = numerator.sign() < 0;
+  BigInteger remainder(numerator);
+  if (negative) {
+    remainder = -remainder;
   }
-  std::string string;
-  BigInteger result = new_numerator / denominator;
-  BigInteger result1 = numerator / denominator;
-  if (precision == 0) {
-    return result1.toString();
-  }
-  rounded_mantissa /= denominator;
-  Rational res = rounded_mantissa;
-  if (res == 0) {
-    string = "0.";
-    for (size_t i = 0; i < precision; ++i) {
-      string += "0";
+  BigInteger integer = remainder / denominator;
+  remainder -= integer * denominator;
+  bool started = integer.sign() != 0;
+  if (started) {
+    if (negative) {
+      out << '-';
+    }
+    out << integer;
+    if (precision != 0) {
+      out << '.';
     }
-    return string;
   }
-  if (result != 0 and numerator < 0) {
-    string = "-";
-    result = -result;
-    result1 = -result1;
+  const BigInteger base(1000000000);
+  size_t zeros = 0;
+  for (size_t written = 0; written < precision; written += 9) {
+    remainder *= base;
+    BigInteger block = remainder / denominator;
+    remainder -= block * denominator;
+    std::string digits = std::to_string(static_cast<long long>(block));
+    digits.insert(0, 9 - digits.size(), '0');
+    digits.resize(std::min<size_t>(9, precision - written));
+    if (!started) {
+      if (digits.find_first_not_of('0') == std::string::npos) {
+        zeros += digits.size();
+        continue;
+      }
+      out << (negative ? "-0." : "0.");
+      for (; zeros != 0; --zeros) {
+        out << '0';
+      }
+      started = true;
+    }
+    out << digits;
   }
-  if (result1 != 0) {
-    for (size_t i = 0; i < result1.toString().size(); ++i) {
-      string += result.toString()[i];
+  if (!started) {
+    out << '0';
+    if (precision != 0) {
+      out << '.';
     }
-    string += ".";
-    for (size_t i = result1.toString().size(); i < std::min(result.toString().size(), precision + result1.toString().size()); ++i) {
-      string += result.toString()[i];
+    for (; zeros != 0; --zeros) {
+      out << '0';
     }
-    if (result.toString().size() - result1.toString().size() < precision) {
-      for (size_t i = result.toString().size() - result1.toString().size(); i < precision; ++i) {
-        string += "0";
-      }
+  }
+}
+
+// Rounds |numerator / denominator| once, to nearest even. The bit lengths settle overflow and
+// underflow up front; otherwise one division with a 62-63 bit quotient gives the significand,
+// and every bit shifted out or left in the remainder only feeds the sticky bit.
+Rational::operator double() const {
+  int sign = numerator.sign();
+  if (sign == 0) {
+    return 0.0;
+  }
+  // |value| lies in [2^(exponent - 1), 2^(exponent + 1)).
+  long long exponent = static_cast<long long>(numerator.bitLength()) - static_cast<long long>(denominator.bitLength());
+  if (exponent > 1025) {
+    return sign * std::numeric_limits<double>::infinity();
+  }
+  if (exponent < -1076) {
+    return sign * 0.0;
+  }
+  long long shift = 62 - exponent;
+  BigInteger scaled = sign < 0 ? -numerator : numerator;
+  bool sticky = false;
+  if (shift >= 0) {
+    scaled <<= static_cast<size_t>(shift);
+  } else {
+    sticky = scaled.trailingZeros() < static_cast<size_t>(-shift);
+    scaled >>= static_cast<size_t>(-shift);
+  }
+  BigInteger quotient = scaled / denominator;
+  sticky = sticky or quotient * denominator != scaled;
+  auto bits = static_cast<unsigned long long>(static_cast<long long>(quotient));
+  // 53 significant bits, fewer once the result is subnormal: its last bit is worth 2^-1074.
+  long long drop = std::max<long long>(std::bit_width(bits) - 53, shift - 1074);
+  unsigned __int128 wide = bits;
+  auto mantissa = static_cast<unsigned long long>(wide >> drop);
+  unsigned __int128 rest = wide & ((static_cast<unsigned __int128>(1) << drop) - 1);
+  unsigned __int128 half = static_cast<unsigned __int128>(1) << (drop - 1);
+  if (rest > half or (rest == half and (sticky or mantissa % 2 == 1))) {
+    ++mantissa;
+  }
+  return sign * std::ldexp(static_cast<double>(mantissa), static_cast<int>(drop - shift));
+}
+
+// Exact value of a finite floating-point number: its integer significand times a power of two.
+template <std::floating_point Float>
+Rational::Rational(Float value) {
+  if (!std::isfinite(value)) {
+    throw std::domain_error("Rational from a non-finite value");
+  }
+  int exponent;
+  Float significand = std::frexp(value, &exponent);
+  significand = std::ldexp(significand, std::numeric_limits<Float>::digits);
+  exponent -= std::numeric_limits<Float>::digits;
+  while (exponent < 0 and significand != 0 and std::fmod(significand, Float(2)) == 0) {
+    significand /= 2;
+    ++exponent;
+  }
+  Float high = std::trunc(std::ldexp(significand, -32));
+  auto low = static_cast<long long>(significand - std::ldexp(high, 32));
+  numerator = (BigInteger(static_cast<long long>(high)) << 32) + low;
+  if (exponent > 0) {
+    numerator <<= static_cast<size_t>(exponent);
+  } else {
+    denominator <<= static_cast<size_t>(-exponent);
+  }
+}
+
+// Continued fraction terms and convergents of a Rational, one at a time. The state is the
+// remaining quotient n / d, which shrinks like in Euclid's algorithm.
+class Convergents {
+private:
+    BigInteger remaining_numerator;
+    BigInteger remaining_denominator;
+    BigInteger previous_numerator = 0;
+    BigInteger previous_denominator = 1;
+    BigInteger current_numerator = 1;
+    BigInteger current_denominator = 0;
+    BigInteger last_term;
+public:
+    explicit Convergents(const Rational& value):
+            remaining_numerator(value.numerator), remaining_denominator(value.denominator) {}
+
+    // Advances to the next convergent, false once the expansion is exhausted.
+    bool next();
+    const BigInteger& term() const {
+      return last_term;
     }
-    return string;
+    const BigInteger& numerator() const {
+      return current_numerator;
+    }
+    const BigInteger& denominator() const {
+      return current_denominator;
+    }
+    const BigInteger& previousNumerator() const {
+      return previous_numerator;
+    }
+    const BigInteger& previousDenominator() const {
+      return previous_denominator;
+    }
+    Rational convergent() const {
+      Rational result;
+      result.numerator = current_numerator;
+      result.denominator = current_denominator;
+      return result;
+    }
+};
+
+bool Convergents::next() {
+  if (remaining_denominator.sign() == 0) {
+    return false;
   }
-  BigInteger new_numerator_1(numerator);
-  new_numerator_1 *= ten;
-  size_t index = 0;
-  string += "0.";
-  while (new_numerator_1 / denominator == 0 and index < precision) {
-    new_numerator_1 *= ten;
-    string += "0";
-    ++index;
+  last_term = remaining_numerator / remaining_denominator;
+  BigInteger rest = remaining_numerator - last_term * remaining_denominator;
+  if (rest.sign() < 0) {
+    --last_term;
+    rest += remaining_denominator;
+  }
+  remaining_numerator = remaining_denominator;
+  remaining_denominator = rest;
+  BigInteger next_numerator = previous_numerator + last_term * current_numerator;
+  BigInteger next_denominator = previous_denominator + last_term * current_denominator;
+  previous_numerator = current_numerator;
+  previous_denominator = current_denominator;
+  current_numerator = next_numerator;
+  current_denominator = next_denominator;
+  return true;
+}
+
+// Closest fraction with denominator at most max_denominator: the last convergent that fits or
+// the best semiconvergent between it and the next one.
+Rational Rational::limitDenominator(const BigInteger& max_denominator) const {
+  if (max_denominator < 1) {
+    throw std::domain_error("limitDenominator needs a positive bound");
+  }
+  if (!(max_denominator < denominator)) {
+    return *this;
   }
-  for (size_t i = 0; i < precision - index; ++i) {
-    string += result.toString()[i];
+  Convergents convergents(*this);
+  bool exceeded = false;
+  while (!exceeded and convergents.next()) {
+    exceeded = max_denominator < convergents.denominator();
   }
-  return string;
+  if (!exceeded) {
+    return convergents.convergent();
+  }
+  Rational best;
+  best.numerator = convergents.previousNumerator();
+  best.denominator = convergents.previousDenominator();
+  BigInteger before_numerator = convergents.numerator() - convergents.term() * best.numerator;
+  BigInteger before_denominator = convergents.denominator() - convergents.term() * best.denominator;
+  BigInteger steps = (max_denominator - before_denominator) / best.denominator;
+  Rational semiconvergent;
+  semiconvergent.numerator = before_numerator + steps * best.numerator;
+  semiconvergent.denominator = before_denominator + steps * best.denominator;
+  Rational best_error = best - *this;
+  Rational semiconvergent_error = semiconvergent - *this;
+  if (best_error < 0) {
+    best_error = -best_error;
+  }
+  if (semiconvergent_error < 0) {
+    semiconvergent_error = -semiconvergent_error;
+  }
+  return best_error <= semiconvergent_error ? best : semiconvergent;
 }
 
 std::string Rational::toString() {
@@ -754,8 +2887,601 @@ std::string Rational::toString() {
   return numerator.toString() + "/" + denominator.toString();
 }
 
+void Rational::writeBinary(std::string& out) const {
+  numerator.writeBinary(out);
+  denominator.writeBinary(out);
+}
+
+const char* Rational::readBinary(const char* begin, const char* end) {
+  BigInteger new_numerator;
+  BigInteger new_denominator;
+  begin = new_numerator.readBinary(begin, end);
+  if (begin != nullptr) {
+    begin = new_denominator.readBinary(begin, end);
+  }
+  if (begin == nullptr) {
+    return nullptr;
+  }
+  numerator = new_numerator;
+  denominator = new_denominator;
+  invalidate();
+  return begin;
+}
+
 Rational operator/(const int first, const Rational& second) {
   Rational result(first);
   result /= second;
   return result;
 }
+
+enum class RoundingMode {
+    HalfEven,
+    HalfUp,
+    HalfDown,
+    Up,
+    Down,
+    Ceiling,
+    Floor
+};
+
+// Fixed-point decimal: unscaled / 10^scale. Addition and subtraction only align scales with a
+// multiplication by a power of ten, and nothing is ever reduced by a gcd.
+class Decimal {
+private:
+    BigInteger unscaled = 0;
+    size_t scale = 0;
+
+    static BigInteger divide(const BigInteger& numerator, const BigInteger& denominator, RoundingMode mode);
+    BigInteger aligned(size_t target_scale) const {
+      return target_scale == scale ? unscaled : unscaled * power(10, target_scale - scale);
+    }
+    int compare(const Decimal& other) const;
+public:
+    Decimal() {}
+    Decimal(long long number): unscaled(number) {}
+    Decimal(long long unscaled, size_t scale): unscaled(unscaled), scale(scale) {}
+    Decimal(BigInteger unscaled, size_t scale): unscaled(std::move(unscaled)), scale(scale) {}
+    explicit Decimal(const std::string& string);
+    Decimal(const Rational& value, size_t scale, RoundingMode mode = RoundingMode::HalfEven);
+
+    const BigInteger& unscaledValue() const {
+      return unscaled;
+    }
+    size_t getScale() const {
+      return scale;
+    }
+    Decimal rescale(size_t new_scale, RoundingMode mode = RoundingMode::HalfEven) const;
+    Decimal divide(const Decimal& other, size_t result_scale, RoundingMode mode = RoundingMode::HalfEven) const;
+
+    Decimal& operator+=(const Decimal& other);
+    Decimal& operator-=(const Decimal& other);
+    Decimal& operator*=(const Decimal& other);
+    Decimal operator+(const Decimal& second) const {
+      Decimal result(*this);
+      result += second;
+      return result;
+    }
+    Decimal operator-(const Decimal& second) const {
+      Decimal result(*this);
+      result -= second;
+      return result;
+    }
+    Decimal operator*(const Decimal& second) const {
+      Decimal result(*this);
+      result *= second;
+      return result;
+    }
+    Decimal operator-() const {
+      return Decimal(-unscaled, scale);
+    }
+
+    bool operator==(const Decimal& other) const {
+      return compare(other) == 0;
+    }
+    bool operator!=(const Decimal& other) const {
+      return compare(other) != 0;
+    }
+    bool operator<(const Decimal& other) const {
+      return compare(other) < 0;
+    }
+    bool operator>(const Decimal& other) const {
+      return compare(other) > 0;
+    }
+    bool operator<=(const Decimal& other) const {
+      return compare(other) <= 0;
+    }
+    bool operator>=(const Decimal& other) const {
+      return compare(other) >= 0;
+    }
+
+    std::string toString() const;
+    explicit operator Rational() const {
+      return Rational(unscaled) / Rational(power(10, scale));
+    }
+};
+
+BigInteger Decimal::divide(const BigInteger& numerator, const BigInteger& denominator, RoundingMode mode) {
+  BigInteger quotient = numerator / denominator;
+  BigInteger remainder = numerator - quotient * denominator;
+  if (remainder.sign() == 0) {
+    return quotient;
+  }
+  int sign = numerator.sign() * denominator.sign();
+  BigInteger twice = remainder * 2;
+  BigInteger magnitude = denominator.sign() < 0 ? -denominator : denominator;
+  if (twice.sign() < 0) {
+    twice = -twice;
+  }
+  int position = twice < magnitude ? -1 : (magnitude < twice ? 1 : 0);
+  bool away = false;
+  switch (mode) {
+    case RoundingMode::HalfEven:
+      away = position > 0 or (position == 0 and (quotient % 2).sign() != 0);
+      break;
+    case RoundingMode::HalfUp:
+      away = position >= 0;
+      break;
+    case RoundingMode::HalfDown:
+      away = position > 0;
+      break;
+    case RoundingMode::Up:
+      away = true;
+      break;
+    case RoundingMode::Down:
+      away = false;
+      break;
+    case RoundingMode::Ceiling:
+      away = sign > 0;
+      break;
+    case RoundingMode::Floor:
+      away = sign < 0;
+      break;
+  }
+  if (away) {
+    quotient += sign;
+  }
+  return quotient;
+}
+
+Decimal::Decimal(const std::string& string) {
+  std::string digits = string;
+  size_t point = digits.find('.');
+  if (point != std::string::npos) {
+    scale = digits.size() - point - 1;
+    digits.erase(point, 1);
+  }
+  unscaled = BigInteger(digits);
+}
+
+Decimal::Decimal(const Rational& value, size_t scale, RoundingMode mode):
+        unscaled(divide(value.numerator * power(10, scale), value.denominator, mode)), scale(scale) {}
+
+Decimal Decimal::rescale(size_t new_scale, RoundingMode mode) const {
+  if (new_scale >= scale) {
+    return Decimal(aligned(new_scale), new_scale);
+  }
+  return Decimal(divide(unscaled, power(10, scale - new_scale), mode), new_scale);
+}
+
+Decimal Decimal::divide(const Decimal& other, size_t result_scale, RoundingMode mode) const {
+  // unscaled / 10^scale / (other.unscaled / 10^other.scale) * 10^result_scale
+  BigInteger numerator = unscaled;
+  BigInteger denominator = other.unscaled;
+  if (result_scale + other.scale >= scale) {
+    numerator *= power(10, result_scale + other.scale - scale);
+  } else {
+    denominator *= power(10, scale - result_scale - other.scale);
+  }
+  return Decimal(divide(numerator, denominator, mode), result_scale);
+}
+
+Decimal& Decimal::operator+=(const Decimal& other) {
+  if (other.scale > scale) {
+    unscaled = aligned(other.scale);
+    scale = other.scale;
+  }
+  unscaled += other.aligned(scale);
+  return *this;
+}
+
+Decimal& Decimal::operator-=(const Decimal& other) {
+  if (other.scale > scale) {
+    unscaled = aligned(other.scale);
+    scale = other.scale;
+  }
+  unscaled -= other.aligned(scale);
+  return *this;
+}
+
+Decimal& Decimal::operator*=(const Decimal& other) {
+  unscaled *= other.unscaled;
+  scale += other.scale;
+  return *this;
+}
+
+int Decimal::compare(const Decimal& other) const {
+  size_t common = std::max(scale, other.scale);
+  BigInteger first = aligned(common);
+  BigInteger second = other.aligned(common);
+  return first < second ? -1 : (second < first ? 1 : 0);
+}
+
+std::string Decimal::toString() const {
+  std::string string = unscaled.toString();
+  if (scale == 0) {
+    return string;
+  }
+  size_t sign = string[0] == '-' ? 1 : 0;
+  if (string.size() - sign <= scale) {
+    string.insert(sign, scale + 1 - (string.size() - sign), '0');
+  }
+  string.insert(string.size() - scale, ".");
+  return string;
+}
+
+std::ostream& operator<<(std::ostream& out, const Decimal& decimal) {
+  out << decimal.toString();
+  return out;
+}
+
+// Dense row-major matrix over BigInteger. Elimination is fraction-free (Bareiss), so every
+// intermediate division is exact and no gcd is ever taken.
+class BigMatrix {
+private:
+    static constexpr int kBase = BigInteger::kBase;
+
+    size_t row_count = 0;
+    size_t column_count = 0;
+    std::vector<BigInteger> cells;
+
+    static BigInteger dot(const BigMatrix& first, const BigMatrix& second, size_t row, size_t column,
+                          std::vector<long long>& sums, std::vector<int>& product);
+    void multiply_rows(const BigMatrix& first, const BigMatrix& second, size_t begin, size_t end);
+    size_t eliminate(size_t columns, bool backward, int& sign);
+public:
+    BigMatrix() = default;
+    BigMatrix(size_t rows, size_t columns): row_count(rows), column_count(columns), cells(rows * columns) {}
+    BigMatrix(const std::vector<std::vector<BigInteger>>& rows);
+
+    size_t rows() const {
+      return row_count;
+    }
+    size_t columns() const {
+      return column_count;
+    }
+    BigInteger& operator()(size_t row, size_t column) {
+      return cells[row * column_count + column];
+    }
+    const BigInteger& operator()(size_t row, size_t column) const {
+      return cells[row * column_count + column];
+    }
+
+    BigMatrix operator*(const BigMatrix& other) const;
+    BigInteger determinant() const;
+    std::vector<Rational> solve(const std::vector<BigInteger>& rhs) const;
+};
+
+BigMatrix::BigMatrix(const std::vector<std::vector<BigInteger>>& rows):
+        row_count(rows.size()), column_count(rows.empty() ? 0 : rows[0].size()) {
+  cells.reserve(row_count * column_count);
+  for (const auto& row : rows) {
+    if (row.size() != column_count) {
+      throw std::invalid_argument("BigMatrix rows of different length");
+    }
+    cells.insert(cells.end(), row.begin(), row.end());
+  }
+}
+
+// Sums the limb products of the whole row-by-column dot product in 64-bit accumulators, one for
+// each sign, and normalizes carries once at the end instead of after every term.
+BigInteger BigMatrix::dot(const BigMatrix& first, const BigMatrix& second, size_t row, size_t column,
+                          std::vector<long long>& sums, std::vector<int>& product) {
+  size_t width = 0;
+  for (size_t k = 0; k < first.column_count; ++k) {
+    width = std::max(width, first(row, k).length + second(k, column).length);
+  }
+  sums.assign(2 * (width + 1), 0);
+  product.resize(width);
+  for (size_t k = 0; k < first.column_count; ++k) {
+    const BigInteger& left = first(row, k);
+    const BigInteger& right = second(k, column);
+    if (left.length == 0 or right.length == 0) {
+      continue;
+    }
+    size_t size = left.length + right.length;
+    BigInteger::multiply_limbs(left.array.data(), left.length, right.array.data(), right.length, product.data(), 1);
+    long long* target = sums.data() + (left.positive == right.positive ? 0 : width + 1);
+    for (size_t i = 0; i < size; ++i) {
+      target[i] += product[i];
+    }
+  }
+  BigInteger parts[2];
+  for (size_t part = 0; part < 2; ++part) {
+    const long long* source = sums.data() + part * (width + 1);
+    parts[part].array.assign(width + 1, 0);
+    long long carry = 0;
+    for (size_t i = 0; i <= width; ++i) {
+      carry += source[i];
+      parts[part].array[i] = static_cast<int>(carry % kBase);
+      carry /= kBase;
+    }
+    parts[part].change_length();
+  }
+  return parts[0] - parts[1];
+}
+
+void BigMatrix::multiply_rows(const BigMatrix& first, const BigMatrix& second, size_t begin, size_t end) {
+  std::vector<long long> sums;
+  std::vector<int> product;
+  for (size_t row = begin; row < end; ++row) {
+    for (size_t column = 0; column < column_count; ++column) {
+      (*this)(row, column) = dot(first, second, row, column, sums, product);
+    }
+  }
+}
+
+// Row blocks of the result are independent and go to separate threads, as many as
+// BigInteger::setMultiplicationThreads allows.
+BigMatrix BigMatrix::operator*(const BigMatrix& other) const {
+  if (column_count != other.row_count) {
+    throw std::invalid_argument("BigMatrix dimensions do not match");
+  }
+  BigMatrix result(row_count, other.column_count);
+  size_t threads = std::min(BigInteger::multiplication_threads, row_count);
+  if (threads <= 1) {
+    result.multiply_rows(*this, other, 0, row_count);
+    return result;
+  }
+  std::vector<std::future<void>> blocks;
+  size_t block = (row_count + threads - 1) / threads;
+  for (size_t begin = block; begin < row_count; begin += block) {
+    blocks.push_back(std::async(std::launch::async, [&result, this, &other, begin, block] {
+      result.multiply_rows(*this, other, begin, std::min(begin + block, row_count));
+    }));
+  }
+  result.multiply_rows(*this, other, 0, block);
+  for (auto& future : blocks) {
+    future.get();
+  }
+  return result;
+}
+
+// Bareiss elimination over the first `columns` columns; with backward set the rows above the
+// pivot are cleared too (fraction-free Gauss-Jordan). Returns the rank reached before a zero column.
+size_t BigMatrix::eliminate(size_t columns, bool backward, int& sign) {
+  BigInteger previous = 1;
+  sign = 1;
+  for (size_t k = 0; k < columns; ++k) {
+    size_t pivot = k;
+    while (pivot < row_count and (*this)(pivot, k).sign() == 0) {
+      ++pivot;
+    }
+    if (pivot == row_count) {
+      return k;
+    }
+    if (pivot != k) {
+      for (size_t j = 0; j < column_count; ++j) {
+        std::swap((*this)(pivot, j), (*this)(k, j));
+      }
+      sign = -sign;
+    }
+    for (size_t i = backward ? 0 : k + 1; i < row_count; ++i) {
+      if (i == k) {
+        continue;
+      }
+      for (size_t j = k + 1; j < column_count; ++j) {
+        (*this)(i, j) = ((*this)(i, j) * (*this)(k, k) - (*this)(i, k) * (*this)(k, j)) / previous;
+      }
+      if (i < k) {
+        (*this)(i, i) = (*this)(k, k);
+      }
+      (*this)(i, k) = 0;
+    }
+    previous = (*this)(k, k);
+  }
+  return columns;
+}
+
+BigInteger BigMatrix::determinant() const {
+  if (row_count != column_count) {
+    throw std::invalid_argument("determinant of a non-square matrix");
+  }
+  if (row_count == 0) {
+    return 1;
+  }
+  BigMatrix copy(*this);
+  int sign = 1;
+  if (copy.eliminate(column_count, false, sign) < column_count) {
+    return 0;
+  }
+  return sign < 0 ? -copy(row_count - 1, column_count - 1) : copy(row_count - 1, column_count - 1);
+}
+
+std::vector<Rational> BigMatrix::solve(const std::vector<BigInteger>& rhs) const {
+  if (row_count != column_count or rhs.size() != row_count) {
+    throw std::invalid_argument("BigMatrix dimensions do not match");
+  }
+  BigMatrix augmented(row_count, column_count + 1);
+  for (size_t i = 0; i < row_count; ++i) {
+    for (size_t j = 0; j < column_count; ++j) {
+      augmented(i, j) = (*this)(i, j);
+    }
+    augmented(i, column_count) = rhs[i];
+  }
+  int sign = 1;
+  if (augmented.eliminate(column_count, true, sign) < column_count) {
+    throw std::domain_error("singular matrix");
+  }
+  std::vector<Rational> solution;
+  solution.reserve(row_count);
+  for (size_t i = 0; i < row_count; ++i) {
+    solution.push_back(Rational(augmented(i, column_count)) / Rational(augmented(i, i)));
+  }
+  return solution;
+}
+
+// Kronecker substitution: both polynomials are evaluated at X = kBase^k, with k limbs wide enough
+// for any coefficient of the product, multiplied once and the product is cut back into balanced
+// base-X digits.
+std::vector<BigInteger> multiplyPolynomials(const std::vector<BigInteger>& first,
+                                            const std::vector<BigInteger>& second) {
+  if (first.empty() or second.empty()) {
+    return {};
+  }
+  BigInteger first_max = 0;
+  BigInteger second_max = 0;
+  for (const auto& coefficient : first) {
+    first_max = std::max(first_max, coefficient.sign() < 0 ? -coefficient : coefficient);
+  }
+  for (const auto& coefficient : second) {
+    second_max = std::max(second_max, coefficient.sign() < 0 ? -coefficient : coefficient);
+  }
+  std::vector<BigInteger> result(first.size() + second.size() - 1);
+  if (first_max.sign() == 0 or second_max.sign() == 0) {
+    return result;
+  }
+  BigInteger bound = first_max * second_max * BigInteger(2 * static_cast<long long>(std::min(first.size(), second.size())));
+  size_t width = bound.length;
+  auto evaluate = [width](const std::vector<BigInteger>& coefficients) {
+    BigInteger parts[2];
+    for (auto& part : parts) {
+      part.array.assign(coefficients.size() * width, 0);
+    }
+    for (size_t i = 0; i < coefficients.size(); ++i) {
+      const BigInteger& coefficient = coefficients[i];
+      std::copy(coefficient.array.begin(), coefficient.array.begin() + static_cast<std::ptrdiff_t>(coefficient.length),
+                parts[coefficient.positive ? 0 : 1].array.begin() + static_cast<std::ptrdiff_t>(i * width));
+    }
+    for (auto& part : parts) {
+      part.change_length();
+    }
+    return parts[0] - parts[1];
+  };
+  BigInteger product = evaluate(first) * evaluate(second);
+  bool negative = product.sign() < 0;
+  BigInteger radix;
+  radix.array.assign(width + 1, 0);
+  radix.array[width] = 1;
+  radix.change_length();
+  BigInteger half;
+  half.array.assign(width, 0);
+  half.array[width - 1] = BigInteger::kBase / 2;
+  half.change_length();
+  int carry = 0;
+  for (size_t i = 0; i < result.size(); ++i) {
+    BigInteger& digit = result[i];
+    size_t begin = std::min(i * width, product.length);
+    size_t end = std::min(begin + width, product.length);
+    digit.array.assign(product.array.begin() + static_cast<std::ptrdiff_t>(begin),
+                       product.array.begin() + static_cast<std::ptrdiff_t>(end));
+    digit.change_length();
+    digit += carry;
+    carry = digit >= half ? 1 : 0;
+    if (carry != 0) {
+      digit -= radix;
+    }
+    if (negative) {
+      digit = -digit;
+    }
+  }
+  return result;
+}
+
+namespace std
+{
+  template <>
+  struct hash<BigInteger> {
+      size_t operator()(const BigInteger& number) const {
+        return number.hash();
+      }
+  };
+
+  template <>
+  struct hash<Rational> {
+      size_t operator()(const Rational& number) const {
+        return number.hash();
+      }
+  };
+}
+
+class BinaryWriter {
+private:
+    static constexpr size_t kChunk = 1 << 16;
+
+    std::ostream& out;
+    std::string buffer;
+public:
+    explicit BinaryWriter(std::ostream& out): out(out) {}
+    BinaryWriter(const BinaryWriter&) = delete;
+
+    template <typename Number>
+    void write(const Number& number) {
+      number.writeBinary(buffer);
+      if (buffer.size() >= kChunk) {
+        flush();
+      }
+    }
+    void flush() {
+      out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+
+    ~BinaryWriter() {
+      flush();
+    }
+};
+
+class BinaryReader {
+private:
+    static constexpr size_t kChunk = 1 << 16;
+
+    std::istream& in;
+    std::string buffer;
+    size_t position = 0;
+
+    bool refill() {
+      buffer.erase(0, position);
+      position = 0;
+      size_t size = buffer.size();
+      buffer.resize(size + kChunk);
+      in.read(buffer.data() + size, static_cast<std::streamsize>(kChunk));
+      buffer.resize(size + static_cast<size_t>(in.gcount()));
+      return buffer.size() > size;
+    }
+public:
+    explicit BinaryReader(std::istream& in): in(in) {}
+    BinaryReader(const BinaryReader&) = delete;
+
+    template <typename Number>
+    bool read(Number& number) {
+      while (true) {
+        const char* next = number.readBinary(buffer.data() + position, buffer.data() + buffer.size());
+        if (next != nullptr) {
+          position = static_cast<size_t>(next - buffer.data());
+          return true;
+        }
+        if (!refill()) {
+          return false;
+        }
+      }
+    }
+};
+
+template <typename Number>
+void writeBinary(std::ostream& out, const std::vector<Number>& numbers) {
+  BinaryWriter writer(out);
+  for (const auto& number : numbers) {
+    writer.write(number);
+  }
+}
+
+template <typename Number>
+std::vector<Number> readBinary(std::istream& in) {
+  BinaryReader reader(in);
+  std::vector<Number> numbers;
+  Number number;
+  while (reader.read(number)) {
+    numbers.push_back(number);
+  }
+  return numbers;
+}
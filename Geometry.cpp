@@ -1,6 +1,19 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 namespace detail
@@ -58,6 +71,135 @@ void Point::reflect(const Point& center) {
   y = 2 * (center.y - y) + y;
 }
 
+namespace detail
+{
+  // With exact predicates on, orientation and incidence tests decide by the exact sign of the
+  // determinant instead of comparing against the 1e-5 tolerance. Atomic since hull and index
+  // workers read it; switch it between computations, not during one.
+  std::atomic<bool> exact_predicates = false;
+
+  // Shewchuk's expansions: sums of non-overlapping doubles in increasing magnitude, so the
+  // last component carries the sign of the exact value.
+  using Expansion = std::vector<double>;
+
+  Expansion Grow(const Expansion& expansion, double number) {
+    Expansion result;
+    double sum = number;
+    for (double component : expansion) {
+      double next = sum + component;
+      double virtual_component = next - sum;
+      double error = (sum - (next - virtual_component)) + (component - virtual_component);
+      if (error != 0) {
+        result.push_back(error);
+      }
+      sum = next;
+    }
+    if (sum != 0) {
+      result.push_back(sum);
+    }
+    return result;
+  }
+
+  Expansion Sum(Expansion first, const Expansion& second) {
+    for (double component : second) {
+      first = Grow(first, component);
+    }
+    return first;
+  }
+
+  Expansion Product(const Expansion& first, const Expansion& second) {
+    Expansion result;
+    for (double left : first) {
+      for (double right : second) {
+        double product = left * right;
+        result = Grow(Grow(result, std::fma(left, right, -product)), product);
+      }
+    }
+    return result;
+  }
+
+  Expansion Negate(Expansion expansion) {
+    for (double& component : expansion) {
+      component = -component;
+    }
+    return expansion;
+  }
+
+  Expansion Difference(double first, double second) {
+    return Grow(Grow({}, first), -second);
+  }
+
+  double Sign(const Expansion& expansion) {
+    return expansion.empty() ? 0 : expansion.back();
+  }
+
+  // Positive if first, second, third make a left turn, zero if collinear. The float result is
+  // returned when it clears the error bound, otherwise the sign is computed exactly.
+  double Orient2d(const Point& first, const Point& second, const Point& third) {
+    constexpr double kEpsilon = std::numeric_limits<double>::epsilon() / 2;
+    constexpr double kBound = (3 + 16 * kEpsilon) * kEpsilon;
+    double left = (first.x - third.x) * (second.y - third.y);
+    double right = (first.y - third.y) * (second.x - third.x);
+    double determinant = left - right;
+    if (std::fabs(determinant) >= kBound * (std::fabs(left) + std::fabs(right))) {
+      return determinant;
+    }
+    Expansion exact = Sum(Product(Difference(first.x, third.x), Difference(second.y, third.y)),
+                          Negate(Product(Difference(first.y, third.y), Difference(second.x, third.x))));
+    return Sign(exact);
+  }
+
+  // Positive if fourth lies inside the circle through the counterclockwise first, second, third.
+  double InCircle(const Point& first, const Point& second, const Point& third, const Point& fourth) {
+    constexpr double kEpsilon = std::numeric_limits<double>::epsilon() / 2;
+    constexpr double kBound = (10 + 96 * kEpsilon) * kEpsilon;
+    double adx = first.x - fourth.x;
+    double ady = first.y - fourth.y;
+    double bdx = second.x - fourth.x;
+    double bdy = second.y - fourth.y;
+    double cdx = third.x - fourth.x;
+    double cdy = third.y - fourth.y;
+    double alift = adx * adx + ady * ady;
+    double blift = bdx * bdx + bdy * bdy;
+    double clift = cdx * cdx + cdy * cdy;
+    double determinant = alift * (bdx * cdy - cdx * bdy) + blift * (cdx * ady - adx * cdy) +
+                         clift * (adx * bdy - bdx * ady);
+    double permanent = (std::fabs(bdx * cdy) + std::fabs(cdx * bdy)) * alift +
+                       (std::fabs(cdx * ady) + std::fabs(adx * cdy)) * blift +
+                       (std::fabs(adx * bdy) + std::fabs(bdx * ady)) * clift;
+    if (std::fabs(determinant) > kBound * permanent) {
+      return determinant;
+    }
+    Expansion ax = Difference(first.x, fourth.x);
+    Expansion ay = Difference(first.y, fourth.y);
+    Expansion bx = Difference(second.x, fourth.x);
+    Expansion by = Difference(second.y, fourth.y);
+    Expansion cx = Difference(third.x, fourth.x);
+    Expansion cy = Difference(third.y, fourth.y);
+    Expansion a_lift = Sum(Product(ax, ax), Product(ay, ay));
+    Expansion b_lift = Sum(Product(bx, bx), Product(by, by));
+    Expansion c_lift = Sum(Product(cx, cx), Product(cy, cy));
+    Expansion exact = Product(a_lift, Sum(Product(bx, cy), Negate(Product(cx, by))));
+    exact = Sum(exact, Product(b_lift, Sum(Product(cx, ay), Negate(Product(ax, cy)))));
+    exact = Sum(exact, Product(c_lift, Sum(Product(ax, by), Negate(Product(bx, ay)))));
+    return Sign(exact);
+  }
+
+  // Twice the signed area of the triangle (first, second, third), positive for a left turn.
+  double Cross(const Point& first, const Point& second, const Point& third) {
+    return (second.x - first.x) * (third.y - first.y) - (second.y - first.y) * (third.x - first.x);
+  }
+
+  // Cross, or the adaptive exact predicate when exact predicates are on.
+  double Orientation(const Point& first, const Point& second, const Point& third) {
+    return exact_predicates ? Orient2d(first, second, third) : Cross(first, second, third);
+  }
+}
+
+void setExactPredicates(bool enabled) {
+  exact_predicates = enabled;
+}
+
 class Line {
 public:
     Point point1;
@@ -89,6 +231,9 @@ std::vector<double> Line::Convert() const {
 }
 
 bool Line::operator==(Line line) const {
+  if (exact_predicates) {
+    return Orient2d(point1, point2, line.point1) == 0 and Orient2d(point1, point2, line.point2) == 0;
+  }
   std::vector<double> convert1 = Convert();
   std::vector<double> convert2 = line.Convert();
   if (CompareVector(convert1, convert2)) {
@@ -132,6 +277,149 @@ double Vector::angle(Vector vector) const {
   return std::acos(scalar_product(vector) / (length() * vector.length()));
 }
 
+// x' = xx * x + xy * y + shift_x, y' = yx * x + yy * y + shift_y.
+struct AffineTransform {
+    double xx = 1;
+    double xy = 0;
+    double yx = 0;
+    double yy = 1;
+    double shift_x = 0;
+    double shift_y = 0;
+
+    AffineTransform() = default;
+    AffineTransform(double xx, double xy, double yx, double yy, double shift_x, double shift_y):
+            xx(xx), xy(xy), yx(yx), yy(yy), shift_x(shift_x), shift_y(shift_y) {};
+
+    static AffineTransform translation(const Vector& shift);
+    static AffineTransform rotation(const Point& center, double angle);
+    static AffineTransform reflection(const Point& center);
+    static AffineTransform reflection(const Line& axis);
+    static AffineTransform scaling(const Point& center, double coefficient);
+
+    Point apply(const Point& point) const {
+      return Point(xx * point.x + xy * point.y + shift_x, yx * point.x + yy * point.y + shift_y);
+    }
+    double determinant() const {
+      return xx * yy - xy * yx;
+    }
+    bool isSimilarity() const {
+      return (CompareDouble(xx, yy) and CompareDouble(xy, -yx)) or (CompareDouble(xx, -yy) and CompareDouble(xy, yx));
+    }
+    // Applies other first, then this.
+    AffineTransform operator*(const AffineTransform& other) const;
+};
+
+AffineTransform AffineTransform::translation(const Vector& shift) {
+  return AffineTransform(1, 0, 0, 1, shift.x, shift.y);
+}
+
+AffineTransform AffineTransform::rotation(const Point& center, double angle) {
+  double angle_cos = std::cos(angle * M_PI / 180.0);
+  double angle_sin = std::sin(angle * M_PI / 180.0);
+  return AffineTransform(angle_cos, -angle_sin, angle_sin, angle_cos,
+                         center.x - center.x * angle_cos + center.y * angle_sin,
+                         center.y - center.x * angle_sin - center.y * angle_cos);
+}
+
+AffineTransform AffineTransform::reflection(const Point& center) {
+  return AffineTransform(-1, 0, 0, -1, 2 * center.x, 2 * center.y);
+}
+
+AffineTransform AffineTransform::reflection(const Line& axis) {
+  Vector normal;
+  normal.x = axis.point1.y - axis.point2.y;
+  normal.y = axis.point2.x - axis.point1.x;
+  double length_normal = normal.length();
+  normal.x /= length_normal;
+  normal.y /= length_normal;
+  double offset = 2.0 * (normal.x * axis.point1.x + normal.y * axis.point1.y);
+  return AffineTransform(1 - 2 * normal.x * normal.x, -2 * normal.x * normal.y,
+                         -2 * normal.x * normal.y, 1 - 2 * normal.y * normal.y,
+                         offset * normal.x, offset * normal.y);
+}
+
+AffineTransform AffineTransform::scaling(const Point& center, double coefficient) {
+  return AffineTransform(coefficient, 0, 0, coefficient, center.x * (1 - coefficient), center.y * (1 - coefficient));
+}
+
+AffineTransform AffineTransform::operator*(const AffineTransform& other) const {
+  return AffineTransform(xx * other.xx + xy * other.yx, xx * other.xy + xy * other.yy,
+                         yx * other.xx + yy * other.yx, yx * other.xy + yy * other.yy,
+                         xx * other.shift_x + xy * other.shift_y + shift_x,
+                         yx * other.shift_x + yy * other.shift_y + shift_y);
+}
+
+// Axis-aligned bounding box; the default one is empty and extend() grows it.
+struct Box {
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = std::numeric_limits<double>::infinity();
+    double max_x = -std::numeric_limits<double>::infinity();
+    double max_y = -std::numeric_limits<double>::infinity();
+
+    Box() = default;
+    Box(double min_x, double min_y, double max_x, double max_y):
+            min_x(min_x), min_y(min_y), max_x(max_x), max_y(max_y) {};
+
+    Point center() const {
+      return Point((min_x + max_x) / 2, (min_y + max_y) / 2);
+    }
+    double area() const {
+      return max_x < min_x ? 0 : (max_x - min_x) * (max_y - min_y);
+    }
+    bool contains(const Point& point) const {
+      return point.x > min_x - 1e-5 and point.x < max_x + 1e-5 and point.y > min_y - 1e-5 and point.y < max_y + 1e-5;
+    }
+    bool intersects(const Box& other) const {
+      return min_x <= other.max_x and other.min_x <= max_x and min_y <= other.max_y and other.min_y <= max_y;
+    }
+    // Squared distance from the point to the box, 0 inside.
+    double distance2(const Point& point) const {
+      double delta_x = std::max({min_x - point.x, 0.0, point.x - max_x});
+      double delta_y = std::max({min_y - point.y, 0.0, point.y - max_y});
+      return delta_x * delta_x + delta_y * delta_y;
+    }
+    void extend(const Box& other) {
+      min_x = std::min(min_x, other.min_x);
+      min_y = std::min(min_y, other.min_y);
+      max_x = std::max(max_x, other.max_x);
+      max_y = std::max(max_y, other.max_y);
+    }
+};
+
+namespace detail
+{
+  bool OnSegment(const Point& point, const Point& first, const Point& second) {
+    if (exact_predicates) {
+      return Orient2d(first, second, point) == 0 and
+             std::min(first.x, second.x) <= point.x and point.x <= std::max(first.x, second.x) and
+             std::min(first.y, second.y) <= point.y and point.y <= std::max(first.y, second.y);
+    }
+    Vector side(first, second);
+    Vector to_point(first, point);
+    double length = side.length();
+    if (CompareDouble(length, 0)) {
+      return point == first;
+    }
+    double cross = side.x * to_point.y - side.y * to_point.x;
+    double projection = side.scalar_product(to_point) / length;
+    return CompareDouble(cross / length, 0) and projection > -1e-5 and projection < length + 1e-5;
+  }
+
+  // Whether the ray from point towards +x crosses the edge; half-open in y, so a vertex on
+  // the ray is counted once.
+  bool CrossesRay(const Point& point, const Point& first, const Point& second) {
+    if ((first.y > point.y) == (second.y > point.y)) {
+      return false;
+    }
+    if (exact_predicates) {
+      // The crossing is right of the point iff the point is left of the edge directed upwards.
+      return (first.y > point.y ? Orient2d(second, first, point) : Orient2d(first, second, point)) > 0;
+    }
+    double x = first.x + (point.y - first.y) * (second.x - first.x) / (second.y - first.y);
+    return point.x < x;
+  }
+}
+
 class Shape {
 public:
     Shape() = default;
@@ -143,32 +431,58 @@ public:
     virtual bool isCongruentTo(const Shape& another) const = 0;
     virtual bool isSimilarTo(const Shape& another) const = 0;
     virtual bool containsPoint(const Point& point) const = 0;
+    virtual Box boundingBox() const = 0;
 
     virtual void rotate(const Point& center, double angle) = 0;
     virtual void reflect(const Point& center) = 0;
     virtual void reflect(const Line& axis) = 0;
     virtual void scale(const Point& center, double coefficient) = 0;
+    virtual void transform(const AffineTransform& transform) = 0;
 
     virtual ~Shape() = default;
 };
 
 class Polygon: public Shape {
 public:
-    std::vector<Point> points;
-
     Polygon(std::vector<Point>& new_points) {
       points = new_points;
     };
-    Polygon(Polygon& polygon) {
+    Polygon(const Polygon& polygon) {
       points = polygon.points;
+      lazy = polygon.lazy;
+      pending = polygon.pending;
+      has_pending = polygon.has_pending;
+      if (polygon.has_transformed) {
+        transformed = polygon.transformed;
+        has_transformed = true;
+      }
+      for (size_t i = 0; i < convexity.size(); ++i) {
+        convexity[i] = polygon.convexity[i].load();
+      }
+      if (polygon.has_signature) {
+        sides = polygon.sides;
+        corners = polygon.corners;
+        has_signature = true;
+      }
     }
-    template<typename... point>
+    template<typename... point> requires (std::convertible_to<point, Point> and ...)
     Polygon(point&&... all_points) {
       (points.push_back(std::forward<point>(all_points)), ...);
     }
 
     void swap(Polygon& other) {
       std::swap(points, other.points);
+      std::swap(lazy, other.lazy);
+      std::swap(pending, other.pending);
+      std::swap(has_pending, other.has_pending);
+      std::swap(transformed, other.transformed);
+      has_transformed = other.has_transformed.exchange(has_transformed);
+      for (size_t i = 0; i < convexity.size(); ++i) {
+        convexity[i] = other.convexity[i].exchange(convexity[i]);
+      }
+      std::swap(sides, other.sides);
+      std::swap(corners, other.corners);
+      has_signature = other.has_signature.exchange(has_signature);
     }
     Polygon& operator=(Polygon other) {
       swap(other);
@@ -179,63 +493,208 @@ public:
       return points.size();
     }
     const std::vector<Point> getVertices() const {
-      return points;
+      return current();
+    }
+    // The vertices with any pending transform applied, without a copy; valid until the polygon
+    // is next modified.
+    const std::vector<Point>& vertices() const {
+      return current();
+    }
+    void setVertices(std::vector<Point> new_points) {
+      points = std::move(new_points);
+      pending = AffineTransform();
+      has_pending = false;
+      has_transformed = false;
+      invalidate();
+    }
+    // In lazy mode transforms pile up in `pending` and reach the vertices on flush() or
+    // setLazy(false); until then const members read a transformed copy, made at most once
+    // per pending transform and adopted by flush().
+    void setLazy(bool enabled) {
+      if (!enabled) {
+        flush();
+      }
+      lazy = enabled;
     }
+    void flush();
     bool isConvex() const;
     double perimeter() const override;
     double area() const override;
+    // Positive for counterclockwise vertices, negative for clockwise ones such as the holes
+    // returned by combine().
+    double signedArea() const;
 
     bool operator==(const Shape& another) const override;
     bool operator!=(const Shape& another) const override {
       return !(*this == another);
     }
 
-    bool ComparePolygons(std::vector<double> first_sides, std::vector<double> first_corners,
-                         std::vector<double> second_sides, std::vector<double> second_corners,
-                         int index, double ratio) const;
     bool isCongruentTo(const Shape& another) const override;
     bool isSimilarTo(const Shape& another) const override;
     bool containsPoint(const Point& point) const override;
+    Box boundingBox() const override;
+    // Hash of the side/angle sequence up to rotation, reflection, scaling and the choice of
+    // the first vertex. Similar polygons collide unless a value falls on a rounding boundary.
+    size_t similarityHash() const;
 
     void rotate(const Point& center, double angle) override;
     void reflect(const Point& center) override;
     void reflect(const Line& axis) override;
     void scale(const Point& center, double coefficient) override;
+    void transform(const AffineTransform& transform) override;
+protected:
+    // The vertices as const members see them: points itself, or transformed, the points with
+    // the pending transform applied, built once per pending transform.
+    const std::vector<Point>& current() const;
+private:
+    static constexpr int kUnknown = 2;
+
+    std::vector<Point> points;
+
+    bool lazy = false;
+    AffineTransform pending;
+    bool has_pending = false;
+    mutable std::vector<Point> transformed;
+    mutable std::atomic<bool> has_transformed = false;
+    mutable std::mutex transformed_mutex;
+
+    // The caches here are filled by const members, possibly from several threads at once:
+    // transformed is built under transformed_mutex, convexity is idempotent to recompute, the
+    // signature is built under signature_mutex.
+
+    // 1 or -1 for a convex polygon traversed counterclockwise or clockwise, 0 if not convex,
+    // indexed by whether exact predicates decided it. Rotations, reflections and non-zero
+    // scaling keep convexity, so transforms only flip the sign.
+    mutable std::array<std::atomic<int>, 2> convexity = {kUnknown, kUnknown};
+
+    // sides[i] = |points[i] points[i + 1]|, corners[i] is the cosine of the angle at points[i + 1].
+    // Similarities keep the angles and scale every side alike, so transforms only rescale them.
+    mutable std::vector<double> sides;
+    mutable std::vector<double> corners;
+    mutable std::atomic<bool> has_signature = false;
+    mutable std::mutex signature_mutex;
+
+    void invalidate() {
+      for (auto& orientation : convexity) {
+        orientation = kUnknown;
+      }
+      has_signature = false;
+    }
+    int compute_convexity(const std::vector<Point>& vertices, bool exact) const;
+    int convexity_under(bool exact) const;
+    bool convex_contains(const std::vector<Point>& vertices, const Point& point, int orientation) const;
+    void compute_signature() const;
+    bool matches(const Polygon& other, double ratio) const;
+    static size_t minimal_rotation(const std::vector<long long>& sequence);
 };
 
-bool Polygon::isConvex() const {
-  int convex = 0;
-  for (size_t i = 0; i < points.size(); ++i) {
-    Vector first_side(points[i], points[(i + 1) % points.size()]);
-    Vector second_side(points[(i + 1) % points.size()], points[(i + 2) % points.size()]);
-    int convex_i = first_side.x * second_side.y - first_side.y * second_side.x;
-    if (convex == 0) {
-      convex = convex_i;
-    } else if (convex < 0 and convex_i > 0) {
-      return false;
-    } else if (convex > 0 and convex_i < 0) {
-      return false;
+int Polygon::compute_convexity(const std::vector<Point>& vertices, bool exact) const {
+  int turn = 0;
+  int x_changes = 0;
+  int y_changes = 0;
+  double previous_x = 0;
+  double previous_y = 0;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    double delta_x = vertices[(i + 1) % vertices.size()].x - vertices[i].x;
+    double delta_y = vertices[(i + 1) % vertices.size()].y - vertices[i].y;
+    previous_x = delta_x != 0 ? delta_x : previous_x;
+    previous_y = delta_y != 0 ? delta_y : previous_y;
+  }
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Point& first = vertices[i];
+    const Point& second = vertices[(i + 1) % vertices.size()];
+    const Point& third = vertices[(i + 2) % vertices.size()];
+    double cross = exact ? Orient2d(first, second, third) : Cross(first, second, third);
+    double scale = Vector(first, second).length() * Vector(second, third).length();
+    if (exact ? cross != 0 : std::fabs(cross) > 1e-9 * scale) {
+      int turn_i = cross > 0 ? 1 : -1;
+      if (turn == 0) {
+        turn = turn_i;
+      } else if (turn != turn_i) {
+        return 0;
+      }
     }
+    // A simple convex polygon changes the direction of its edges along each axis at most twice;
+    // this rules out self-intersecting ones that turn the same way all along.
+    double delta_x = second.x - first.x;
+    double delta_y = second.y - first.y;
+    x_changes += delta_x * previous_x < 0;
+    y_changes += delta_y * previous_y < 0;
+    previous_x = delta_x != 0 ? delta_x : previous_x;
+    previous_y = delta_y != 0 ? delta_y : previous_y;
   }
-  return true;
+  if (x_changes > 2 or y_changes > 2) {
+    return 0;
+  }
+  return turn == 0 ? 1 : turn;
+}
+
+void Polygon::flush() {
+  if (!has_pending) {
+    return;
+  }
+  if (has_transformed) {
+    std::swap(points, transformed);
+  } else {
+    for (auto& point : points) {
+      point = pending.apply(point);
+    }
+  }
+  pending = AffineTransform();
+  has_pending = false;
+  has_transformed = false;
+}
+
+const std::vector<Point>& Polygon::current() const {
+  if (!has_pending) {
+    return points;
+  }
+  if (!has_transformed) {
+    std::lock_guard<std::mutex> lock(transformed_mutex);
+    if (!has_transformed) {
+      transformed.resize(points.size());
+      for (size_t i = 0; i < points.size(); ++i) {
+        transformed[i] = pending.apply(points[i]);
+      }
+      has_transformed = true;
+    }
+  }
+  return transformed;
+}
+
+int Polygon::convexity_under(bool exact) const {
+  if (convexity[exact] == kUnknown) {
+    convexity[exact] = compute_convexity(current(), exact);
+  }
+  return convexity[exact];
+}
+
+bool Polygon::isConvex() const {
+  return convexity_under(exact_predicates) != 0;
 }
 
 double Polygon::perimeter() const {
+  const std::vector<Point>& vertices = current();
   double perimeter = 0;
-  for (size_t i = 0; i < points.size(); ++i) {
-    Vector side(points[i], points[(i + 1) % points.size()]);
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    Vector side(vertices[i], vertices[(i + 1) % vertices.size()]);
     perimeter += side.length();
   }
   return perimeter;
 }
 
 double Polygon::area() const {
+  return std::fabs(signedArea());
+}
+
+double Polygon::signedArea() const {
+  const std::vector<Point>& vertices = current();
   double area = 0;
-  for (size_t i = 0; i < points.size(); ++i) {
-    Point second_point = points[(i + 1) % points.size()];
-    area += points[i].x * second_point.y - second_point.x * points[i].y;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    Point second_point = vertices[(i + 1) % vertices.size()];
+    area += vertices[i].x * second_point.y - second_point.x * vertices[i].y;
   }
-  return 0.5 * std::fabs(area);
+  return 0.5 * area;
 }
 
 bool Polygon::operator==(const Shape& another) const {
@@ -243,16 +702,18 @@ bool Polygon::operator==(const Shape& another) const {
   if (polygon == nullptr) {
     return false;
   }
+  const std::vector<Point>& vertices = current();
+  const std::vector<Point>& other_vertices = polygon->current();
 
-  if (points.size() != polygon->points.size()) {
+  if (vertices.size() != other_vertices.size()) {
     return false;
   }
 
-  int size = static_cast<int>(points.size());
+  int size = static_cast<int>(vertices.size());
   int index_same;
   bool same = false;
   for (int i = 0; i < size; ++i) {
-    if (points[0] == polygon->points[i]) {
+    if (vertices[0] == other_vertices[i]) {
       index_same = i;
       same = true;
       break;
@@ -263,16 +724,16 @@ bool Polygon::operator==(const Shape& another) const {
     return false;
   }
 
-  if (points[1] == polygon->points[(index_same + 1) % size]) {
+  if (vertices[1] == other_vertices[(index_same + 1) % size]) {
     for (int i = 0; i < size; ++i) {
-      if (points[i] != polygon->points[(i + index_same) % size]) {
+      if (vertices[i] != other_vertices[(i + index_same) % size]) {
         return false;
       }
     }
     return true;
-  } else if (points[1] == polygon->points[(index_same - 1 + size) % size]) {
+  } else if (vertices[1] == other_vertices[(index_same - 1 + size) % size]) {
     for (int i = 0; i < size; ++i) {
-      if (points[i] != polygon->points[(index_same - i + size) % size]) {
+      if (vertices[i] != other_vertices[(index_same - i + size) % size]) {
         return false;
       }
     }
@@ -281,151 +742,939 @@ bool Polygon::operator==(const Shape& another) const {
   return false;
 }
 
-bool Polygon::ComparePolygons(std::vector<double> first_sides, std::vector<double> first_corners,
-                              std::vector<double> second_sides, std::vector<double> second_corners,
-                              int index, double ratio) const {
-  int size = static_cast<int>(points.size());
-  if (CompareDouble(first_sides[1], second_sides[(index + 1) % size] * ratio)) {
-    for (int j = 0; j < size; ++j) {
-      if (!CompareDouble(first_sides[j], second_sides[(j + index) % size] * ratio)) {
-        return false;
+void Polygon::compute_signature() const {
+  if (has_signature) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(signature_mutex);
+  if (has_signature) {
+    return;
+  }
+  const std::vector<Point>& vertices = current();
+  size_t size = vertices.size();
+  sides.resize(size);
+  corners.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    Vector first_side(vertices[i], vertices[(i + 1) % size]);
+    Vector second_side(vertices[(i + 1) % size], vertices[(i + 2) % size]);
+    sides[i] = first_side.length();
+    corners[i] = first_side.cos(second_side);
+  }
+  has_signature = true;
+}
+
+// KMP search of this signature in the doubled signature of other, read in both directions,
+// with the sides of other multiplied by ratio. O(n) per direction.
+// KMP needs a transitive equality, which the tolerant CompareDouble is not, so it runs on the
+// entries rounded like in similarityHash and every occurrence it reports is re-checked with
+// the tolerance. Rounding only splits tolerant-equal entries when one of ours lies within the
+// tolerance of a rounding boundary; then, if KMP found nothing, every rotation in both
+// directions is compared directly, which is O(n^2) in the worst case.
+bool Polygon::matches(const Polygon& other, double ratio) const {
+  compute_signature();
+  other.compute_signature();
+  size_t size = sides.size();
+  if (size == 0) {
+    return false;
+  }
+  double total = 0;
+  for (double side : sides) {
+    total += side;
+  }
+  double side_scale = total > 0 ? 1e4 / total : 1;
+  auto token = [side_scale](double side, double corner) {
+    return std::llround(side * side_scale) * 20001 + std::llround((corner + 1) * 1e4);
+  };
+  auto near_boundary = [](double scaled, double slack) {
+    return std::fabs(scaled - std::floor(scaled) - 0.5) < slack;
+  };
+  std::vector<long long> pattern(size);
+  bool ambiguous = false;
+  for (size_t i = 0; i < size; ++i) {
+    pattern[i] = token(sides[i], corners[i]);
+    ambiguous = ambiguous or near_boundary(sides[i] * side_scale, 1e-5 * side_scale) or
+                near_boundary((corners[i] + 1) * 1e4, 1e-5 * 1e4);
+  }
+  std::vector<size_t> failure(size, 0);
+  for (size_t i = 1, k = 0; i < size; ++i) {
+    while (k > 0 and pattern[i] != pattern[k]) {
+      k = failure[k - 1];
+    }
+    if (pattern[i] == pattern[k]) {
+      ++k;
+    }
+    failure[i] = k;
+  }
+  for (bool reversed : {false, true}) {
+    // Read backwards, side j of other is sides[n - 1 - j] and its corner is corners[n - 2 - j].
+    auto other_side = [&](size_t text) {
+      return other.sides[(reversed ? 2 * size - 1 - text % size : text) % size] * ratio;
+    };
+    auto other_corner = [&](size_t text) {
+      return other.corners[(reversed ? 2 * size - 2 - text % size : text) % size];
+    };
+    auto same_from = [&](size_t start) {
+      for (size_t i = 0; i < size; ++i) {
+        if (!CompareDouble(sides[i], other_side(start + i)) or !CompareDouble(corners[i], other_corner(start + i))) {
+          return false;
+        }
       }
-      if (!CompareDouble(first_corners[j], second_corners[(j + index - 1) % size])) {
-        return false;
+      return true;
+    };
+    for (size_t text = 0, k = 0; text + 1 < 2 * size; ++text) {
+      long long current = token(other_side(text), other_corner(text));
+      while (k > 0 and current != pattern[k]) {
+        k = failure[k - 1];
       }
-    }
-    return true;
-  } else if (CompareDouble(first_sides[1], second_sides[(points.size() + index - 1) % points.size()] * ratio)) {
-    for (int j = 0; j < size; ++j) {
-      if (!CompareDouble(first_sides[j], second_sides[(points.size() + index - j) % points.size()] * ratio)) {
-        return false;
+      if (current == pattern[k]) {
+        ++k;
       }
-      if (!CompareDouble(first_corners[(j)  % points.size()], second_corners[(points.size() + index - j - 1) % points.size()])) {
-        return false;
+      if (k == size) {
+        if (same_from(text + 1 - size)) {
+          return true;
+        }
+        k = failure[k - 1];
+      }
+    }
+    if (ambiguous) {
+      for (size_t start = 0; start < size; ++start) {
+        if (same_from(start)) {
+          return true;
+        }
       }
     }
-    return true;
   }
   return false;
 }
+
 bool Polygon::isCongruentTo(const Shape& another) const {
   const auto* polygon = dynamic_cast<const Polygon*>(&another);
   if (polygon == nullptr) {
     return false;
   }
-
   if (points.size() != polygon->points.size()) {
     return false;
   }
+  return matches(*polygon, 1);
+}
 
-  int size = static_cast<int>(points.size());
-  std::vector<double> first_sides;
-  std::vector<double> first_corners;
-  std::vector<double> second_sides;
-  std::vector<double> second_corners;
+bool Polygon::isSimilarTo(const Shape& another) const {
+  const auto* polygon = dynamic_cast<const Polygon*>(&another);
+  if (polygon == nullptr) {
+    return false;
+  }
+  if (points.size() != polygon->points.size()) {
+    return false;
+  }
+  return matches(*polygon, perimeter() / polygon->perimeter());
+}
 
-  for (size_t i = 0; i < points.size(); ++i) {
-    Vector side1_first(points[i], points[(i + 1) % points.size()]);
-    Vector side2_first(points[(i + 1) % points.size()], points[(i + 2) % points.size()]);
-    first_sides.push_back(side1_first.length());
-    first_corners.push_back(side1_first.cos(side2_first));
-    Vector side1_second(polygon->points[i], polygon->points[(i + 1) % points.size()]);
-    Vector side2_second(polygon->points[(i + 1) % points.size()], polygon->points[(i + 2) % points.size()]);
-    second_sides.push_back(side1_second.length());
-    second_corners.push_back(side1_second.cos(side2_second));
+// Booth's algorithm: start of the lexicographically least rotation, O(n).
+size_t Polygon::minimal_rotation(const std::vector<long long>& sequence) {
+  size_t size = sequence.size();
+  std::vector<long long> failure(2 * size, -1);
+  size_t start = 0;
+  for (size_t j = 1; j < 2 * size; ++j) {
+    long long current = sequence[j % size];
+    long long i = failure[j - start - 1];
+    while (i != -1 and current != sequence[(start + static_cast<size_t>(i) + 1) % size]) {
+      if (current < sequence[(start + static_cast<size_t>(i) + 1) % size]) {
+        start = j - static_cast<size_t>(i) - 1;
+      }
+      i = failure[static_cast<size_t>(i)];
+    }
+    if (current != sequence[(start + static_cast<size_t>(i) + 1) % size]) {
+      if (current < sequence[start % size]) {
+        start = j;
+      }
+      failure[j - start] = -1;
+    } else {
+      failure[j - start] = i + 1;
+    }
   }
+  return start % size;
+}
 
-  for (int i = 0; i < size; ++i) {
-    if (CompareDouble(first_sides[0], second_sides[i])) {
-      if (ComparePolygons(first_sides, first_corners, second_sides, second_corners, i, 1)) {
-        return true;
+size_t Polygon::similarityHash() const {
+  compute_signature();
+  size_t size = sides.size();
+  double total = 0;
+  for (double side : sides) {
+    total += side;
+  }
+  // Each vertex becomes one token: side as a share of the perimeter and the corner cosine,
+  // both rounded to 1e-4.
+  std::vector<long long> forward(size);
+  std::vector<long long> backward(size);
+  for (size_t i = 0; i < size; ++i) {
+    auto token = [&](size_t side, size_t corner) {
+      long long side_share = std::llround(sides[side] / total * 1e4);
+      long long cosine = std::llround((corners[corner] + 1) * 1e4);
+      return side_share * 20001 + cosine;
+    };
+    forward[i] = token(i, i);
+    backward[i] = token(size - 1 - i, (2 * size - 2 - i) % size);
+  }
+  size_t hash = std::hash<size_t>()(size);
+  if (size == 0 or !(total > 0)) {
+    return hash;
+  }
+  size_t forward_start = minimal_rotation(forward);
+  size_t backward_start = minimal_rotation(backward);
+  const std::vector<long long>* best = &forward;
+  size_t best_start = forward_start;
+  for (size_t i = 0; i < size; ++i) {
+    long long first = forward[(forward_start + i) % size];
+    long long second = backward[(backward_start + i) % size];
+    if (first != second) {
+      if (second < first) {
+        best = &backward;
+        best_start = backward_start;
       }
+      break;
     }
   }
-  return false;
+  for (size_t i = 0; i < size; ++i) {
+    hash = hash * 1000003 ^ std::hash<long long>()((*best)[(best_start + i) % size]);
+  }
+  return hash;
 }
-bool Polygon::isSimilarTo(const Shape& another) const {
-  const auto* polygon = dynamic_cast<const Polygon*>(&another);
-  if (polygon == nullptr) {
-    return false;
+
+// Binary search for the wedge of the fan from vertices[0] that holds the point, O(log n).
+bool Polygon::convex_contains(const std::vector<Point>& vertices, const Point& point, int orientation) const {
+  size_t size = vertices.size();
+  auto turn = [orientation](const Point& first, const Point& second, const Point& third) {
+    return orientation * Orientation(first, second, third);
+  };
+  if (turn(vertices[0], vertices[1], point) < 0 or turn(vertices[0], vertices[size - 1], point) > 0) {
+    return OnSegment(point, vertices[0], vertices[1]) or OnSegment(point, vertices[size - 1], vertices[0]);
+  }
+  size_t low = 1;
+  size_t high = size - 1;
+  while (high - low > 1) {
+    size_t middle = (low + high) / 2;
+    if (turn(vertices[0], vertices[middle], point) >= 0) {
+      low = middle;
+    } else {
+      high = middle;
+    }
   }
+  return turn(vertices[low], vertices[high], point) >= 0 or OnSegment(point, vertices[low], vertices[high]);
+}
 
-  if (points.size() != polygon->points.size()) {
-    return false;
+bool Polygon::containsPoint(const Point& point) const {
+  const std::vector<Point>& vertices = current();
+  int orientation = vertices.size() >= 3 ? convexity_under(exact_predicates) : 0;
+  if (orientation != 0) {
+    return convex_contains(vertices, point, orientation);
+  }
+  bool inside = false;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Point& first = vertices[i];
+    const Point& second = vertices[(i + 1) % vertices.size()];
+    if (OnSegment(point, first, second)) {
+      return true;
+    }
+    inside ^= CrossesRay(point, first, second);
+  }
+  return inside;
+}
+
+Box Polygon::boundingBox() const {
+  const std::vector<Point>& vertices = current();
+  Box box;
+  for (const auto& point : vertices) {
+    box.extend(Box(point.x, point.y, point.x, point.y));
+  }
+  return box;
+}
+
+void Polygon::rotate(const Point& center, double angle) {
+  transform(AffineTransform::rotation(center, angle));
+}
+
+void Polygon::reflect(const Point& center) {
+  transform(AffineTransform::reflection(center));
+}
+
+void Polygon::reflect(const Line& axis) {
+  transform(AffineTransform::reflection(axis));
+}
+
+void Polygon::scale(const Point& center, double coefficient) {
+  transform(AffineTransform::scaling(center, coefficient));
+}
+
+void Polygon::transform(const AffineTransform& transform) {
+  double determinant = transform.determinant();
+  if (determinant == 0) {
+    invalidate();
+  } else if (determinant < 0) {
+    for (auto& orientation : convexity) {
+      int value = orientation;
+      orientation = value == kUnknown ? kUnknown : -value;
+    }
+  }
+  if (has_signature and transform.isSimilarity()) {
+    double coefficient = std::sqrt(std::fabs(determinant));
+    for (double& side : sides) {
+      side *= coefficient;
+    }
+  } else {
+    has_signature = false;
+  }
+  if (lazy) {
+    pending = transform * pending;
+    has_pending = true;
+    has_transformed = false;
+    return;
+  }
+  flush();
+  for (auto& point : points) {
+    point = transform.apply(point);
   }
+}
 
-  int size = static_cast<int>(points.size());
-  std::vector<double> first_sides;
-  std::vector<double> first_corners;
-  std::vector<double> second_sides;
-  std::vector<double> second_corners;
+// Polygon vertices as separate x and y arrays. Every transform is one branch-free loop over
+// contiguous doubles that the compiler can vectorize.
+class PolygonSoA {
+private:
+    std::vector<double> xs;
+    std::vector<double> ys;
+public:
+    PolygonSoA() = default;
+    explicit PolygonSoA(const Polygon& polygon);
 
+    size_t size() const {
+      return xs.size();
+    }
+    Point operator[](size_t index) const {
+      return Point(xs[index], ys[index]);
+    }
+    const std::vector<double>& x() const {
+      return xs;
+    }
+    const std::vector<double>& y() const {
+      return ys;
+    }
+    Polygon toPolygon() const;
+
+    double area() const;
+    double perimeter() const;
+
+    void translate(const Vector& shift);
+    void rotate(const Point& center, double angle);
+    void reflect(const Point& center);
+    void reflect(const Line& axis);
+    void scale(const Point& center, double coefficient);
+    void transform(const AffineTransform& transform);
+};
+
+PolygonSoA::PolygonSoA(const Polygon& polygon) {
+  const std::vector<Point> points = polygon.getVertices();
+  xs.resize(points.size());
+  ys.resize(points.size());
   for (size_t i = 0; i < points.size(); ++i) {
-    Vector side1_first(points[i], points[(i + 1) % points.size()]);
-    Vector side2_first(points[(i + 1) % points.size()], points[(i + 2) % points.size()]);
-    first_sides.push_back(side1_first.length());
-    first_corners.push_back(side1_first.cos(side2_first));
-    Vector side1_second(polygon->points[i], polygon->points[(i + 1) % points.size()]);
-    Vector side2_second(polygon->points[(i + 1) % points.size()], polygon->points[(i + 2) % points.size()]);
-    second_sides.push_back(side1_second.length());
-    second_corners.push_back(side1_second.cos(side2_second));
+    xs[i] = points[i].x;
+    ys[i] = points[i].y;
   }
+}
 
-  for (int i = 0; i < size; ++i) {
-    double ratio = first_sides[0] / second_sides[i];
-    if (ComparePolygons(first_sides, first_corners, second_sides, second_corners, i, ratio)) {
+Polygon PolygonSoA::toPolygon() const {
+  std::vector<Point> points(xs.size());
+  for (size_t i = 0; i < xs.size(); ++i) {
+    points[i] = Point(xs[i], ys[i]);
+  }
+  return Polygon(points);
+}
+
+void PolygonSoA::transform(const AffineTransform& transform) {
+  double xx = transform.xx;
+  double xy = transform.xy;
+  double yx = transform.yx;
+  double yy = transform.yy;
+  double shift_x = transform.shift_x;
+  double shift_y = transform.shift_y;
+  double* x = xs.data();
+  double* y = ys.data();
+  size_t size = xs.size();
+  for (size_t i = 0; i < size; ++i) {
+    double old_x = x[i];
+    double old_y = y[i];
+    x[i] = xx * old_x + xy * old_y + shift_x;
+    y[i] = yx * old_x + yy * old_y + shift_y;
+  }
+}
+
+// The shoelace and perimeter sums are split into four partial sums so that the additions
+// are independent and can go to separate vector lanes.
+double PolygonSoA::area() const {
+  size_t size = xs.size();
+  if (size < 3) {
+    return 0;
+  }
+  const double* x = xs.data();
+  const double* y = ys.data();
+  double sums[4] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + 4 < size; i += 4) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      sums[lane] += x[i + lane] * y[i + lane + 1] - x[i + lane + 1] * y[i + lane];
+    }
+  }
+  for (; i + 1 < size; ++i) {
+    sums[0] += x[i] * y[i + 1] - x[i + 1] * y[i];
+  }
+  sums[0] += x[size - 1] * y[0] - x[0] * y[size - 1];
+  return 0.5 * std::fabs((sums[0] + sums[1]) + (sums[2] + sums[3]));
+}
+
+double PolygonSoA::perimeter() const {
+  size_t size = xs.size();
+  if (size < 2) {
+    return 0;
+  }
+  const double* x = xs.data();
+  const double* y = ys.data();
+  double sums[4] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + 4 < size; i += 4) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      double delta_x = x[i + lane + 1] - x[i + lane];
+      double delta_y = y[i + lane + 1] - y[i + lane];
+      sums[lane] += std::sqrt(delta_x * delta_x + delta_y * delta_y);
+    }
+  }
+  for (; i + 1 < size; ++i) {
+    double delta_x = x[i + 1] - x[i];
+    double delta_y = y[i + 1] - y[i];
+    sums[0] += std::sqrt(delta_x * delta_x + delta_y * delta_y);
+  }
+  double delta_x = x[0] - x[size - 1];
+  double delta_y = y[0] - y[size - 1];
+  sums[0] += std::sqrt(delta_x * delta_x + delta_y * delta_y);
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+void PolygonSoA::translate(const Vector& shift) {
+  transform(AffineTransform::translation(shift));
+}
+
+void PolygonSoA::rotate(const Point& center, double angle) {
+  transform(AffineTransform::rotation(center, angle));
+}
+
+void PolygonSoA::reflect(const Point& center) {
+  transform(AffineTransform::reflection(center));
+}
+
+void PolygonSoA::reflect(const Line& axis) {
+  transform(AffineTransform::reflection(axis));
+}
+
+void PolygonSoA::scale(const Point& center, double coefficient) {
+  transform(AffineTransform::scaling(center, coefficient));
+}
+
+// Read-only snapshot of a polygon for repeated point queries. Edges are binned into horizontal
+// bands of equal height, so a query only runs the crossing test on the edges of its own band.
+class PreparedPolygon {
+private:
+    struct Edge {
+        Point first;
+        Point second;
+    };
+
+    // An edge is listed in every band it touches only if that is at most kMaxSpan bands; longer
+    // edges go to long_edges, which every query scans, so storage stays O(kMaxSpan * n).
+    static constexpr size_t kMaxSpan = 4;
+
+    std::vector<Edge> edges;
+    std::vector<size_t> band_offsets;
+    std::vector<size_t> band_edges;
+    std::vector<size_t> long_edges;
+    double min_x = 0;
+    double max_x = 0;
+    double min_y = 0;
+    double band_height = 1;
+    size_t band_count = 0;
+
+    size_t band(double y) const;
+public:
+    explicit PreparedPolygon(const Polygon& polygon);
+
+    bool containsPoint(const Point& point) const;
+    std::vector<uint64_t> containsPoints(std::span<const Point> points) const;
+};
+
+PreparedPolygon::PreparedPolygon(const Polygon& polygon) {
+  const std::vector<Point> points = polygon.getVertices();
+  if (points.empty()) {
+    return;
+  }
+  double max_y = points[0].y;
+  min_x = max_x = points[0].x;
+  min_y = points[0].y;
+  for (const auto& point : points) {
+    min_x = std::min(min_x, point.x);
+    max_x = std::max(max_x, point.x);
+    min_y = std::min(min_y, point.y);
+    max_y = std::max(max_y, point.y);
+  }
+  for (size_t i = 0; i < points.size(); ++i) {
+    edges.push_back({points[i], points[(i + 1) % points.size()]});
+  }
+  band_count = edges.size();
+  band_height = (max_y - min_y) / static_cast<double>(band_count);
+  if (!(band_height > 0)) {
+    band_count = 1;
+    band_height = 1;
+  }
+  // Counting sort of (band, edge) pairs; the y-range of an edge is widened by the comparison
+  // tolerance so that boundary points near a band border still see the edge.
+  band_offsets.assign(band_count + 1, 0);
+  std::vector<std::pair<size_t, size_t>> spans(edges.size());
+  for (size_t index = 0; index < edges.size(); ++index) {
+    const Edge& edge = edges[index];
+    spans[index] = {band(std::min(edge.first.y, edge.second.y) - 1e-5),
+                    band(std::max(edge.first.y, edge.second.y) + 1e-5)};
+    auto [low, high] = spans[index];
+    if (high - low >= kMaxSpan) {
+      long_edges.push_back(index);
+      continue;
+    }
+    for (size_t i = low; i <= high; ++i) {
+      ++band_offsets[i + 1];
+    }
+  }
+  for (size_t i = 0; i < band_count; ++i) {
+    band_offsets[i + 1] += band_offsets[i];
+  }
+  band_edges.resize(band_offsets[band_count]);
+  std::vector<size_t> filled(band_offsets.begin(), band_offsets.end() - 1);
+  for (size_t index = 0; index < edges.size(); ++index) {
+    auto [low, high] = spans[index];
+    if (high - low >= kMaxSpan) {
+      continue;
+    }
+    for (size_t i = low; i <= high; ++i) {
+      band_edges[filled[i]++] = index;
+    }
+  }
+}
+
+size_t PreparedPolygon::band(double y) const {
+  double position = std::floor((y - min_y) / band_height);
+  if (!(position > 0)) {
+    return 0;
+  }
+  return std::min(static_cast<size_t>(position), band_count - 1);
+}
+
+bool PreparedPolygon::containsPoint(const Point& point) const {
+  if (edges.empty() or point.x < min_x - 1e-5 or point.x > max_x + 1e-5 or point.y < min_y - 1e-5 or
+      point.y > min_y + band_height * static_cast<double>(band_count) + 1e-5) {
+    return false;
+  }
+  size_t current = band(point.y);
+  bool inside = false;
+  auto visit = [&](size_t index) {
+    const Edge& edge = edges[index];
+    if (OnSegment(point, edge.first, edge.second)) {
+      return true;
+    }
+    inside ^= CrossesRay(point, edge.first, edge.second);
+    return false;
+  };
+  for (size_t i = band_offsets[current]; i < band_offsets[current + 1]; ++i) {
+    if (visit(band_edges[i])) {
       return true;
     }
   }
-  return false;
+  for (size_t index : long_edges) {
+    const Edge& edge = edges[index];
+    if (point.y < std::min(edge.first.y, edge.second.y) - 1e-5 or point.y > std::max(edge.first.y, edge.second.y) + 1e-5) {
+      continue;
+    }
+    if (visit(index)) {
+      return true;
+    }
+  }
+  return inside;
 }
 
-bool Polygon::containsPoint(const Point& point) const {
-  double angle = 0;
-  for (int i = 0; i < static_cast<int>(points.size()); ++i) {
-    Vector side1(point, points[i]);
-    Vector side2(point, points[(i + 1) % points.size()]);
-    angle += side1.angle(side2);
+// Bit i % 64 of word i / 64 is set when points[i] is inside.
+std::vector<uint64_t> PreparedPolygon::containsPoints(std::span<const Point> points) const {
+  std::vector<uint64_t> mask((points.size() + 63) / 64, 0);
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (containsPoint(points[i])) {
+      mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
   }
-  std::cerr << "point" << point.x << " " << point.y << "\n";
-  for (auto x: points) std::cerr << x.x << " " << x.y << "\n";
-  return CompareDouble(angle, 2 * M_PI);
+  return mask;
 }
 
-void Polygon::rotate(const Point& center, double angle) {
-  for (auto& point : points) {
-    point.rotate(center, angle);
+namespace detail
+{
+  // Andrew's monotone chain over points sorted by (x, y); counterclockwise, collinear points dropped.
+  std::vector<Point> MonotoneChain(const std::vector<Point>& sorted) {
+    if (sorted.size() < 3) {
+      return sorted;
+    }
+    std::vector<Point> hull(2 * sorted.size());
+    size_t size = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+      while (size >= 2 and Orientation(hull[size - 2], hull[size - 1], sorted[i]) <= 0) {
+        --size;
+      }
+      hull[size++] = sorted[i];
+    }
+    for (size_t i = sorted.size() - 1, lower = size + 1; i > 0; --i) {
+      while (size >= lower and Orientation(hull[size - 2], hull[size - 1], sorted[i - 1]) <= 0) {
+        --size;
+      }
+      hull[size++] = sorted[i - 1];
+    }
+    hull.resize(size - 1);
+    return hull;
+  }
+
+  bool PointLess(const Point& first, const Point& second) {
+    return first.x < second.x or (first.x == second.x and first.y < second.y);
   }
 }
 
-void Polygon::reflect(const Point& center) {
-  for (auto& point : points) {
-    point.reflect(center);
+// Convex hull as a counterclockwise polygon. With threads > 1 the points are cut into chunks
+// that are sorted and hulled on their own threads; the hull of the chunk hulls is the answer.
+Polygon convexHull(std::vector<Point> points, size_t threads = 1) {
+  threads = std::max<size_t>(1, std::min(threads, points.size() / 16384));
+  if (threads > 1) {
+    size_t chunk = (points.size() + threads - 1) / threads;
+    std::vector<std::future<std::vector<Point>>> hulls;
+    for (size_t begin = 0; begin < points.size(); begin += chunk) {
+      hulls.push_back(std::async(std::launch::async, [&points, begin, chunk] {
+        std::vector<Point> part(points.begin() + static_cast<std::ptrdiff_t>(begin),
+                                points.begin() + static_cast<std::ptrdiff_t>(std::min(begin + chunk, points.size())));
+        std::sort(part.begin(), part.end(), PointLess);
+        return MonotoneChain(part);
+      }));
+    }
+    std::vector<Point> candidates;
+    for (auto& hull : hulls) {
+      std::vector<Point> part = hull.get();
+      candidates.insert(candidates.end(), part.begin(), part.end());
+    }
+    points = std::move(candidates);
   }
+  std::sort(points.begin(), points.end(), PointLess);
+  points.erase(std::unique(points.begin(), points.end(), [](const Point& first, const Point& second) {
+    return first.x == second.x and first.y == second.y;
+  }), points.end());
+  std::vector<Point> hull = MonotoneChain(points);
+  return Polygon(hull);
 }
 
-void Polygon::reflect(const Line& axis) {
-  Vector normal;
-  normal.x = axis.point1.y - axis.point2.y;
-  normal.y = axis.point2.x - axis.point1.x;
-  double length_normal = normal.length();
-  normal.x /= length_normal;
-  normal.y /= length_normal;
-  for (auto& point : points) {
-    double scalar = 2.0 * (normal.x * point.x + normal.y * point.y);
-    point.x -= scalar * normal.x;
-    point.y -= scalar * normal.y;
+// Sutherland-Hodgman: the subject is cut by the half-plane of every edge of the convex clip
+// polygon in turn, O(n * m). A concave subject whose intersection falls apart comes out as one
+// ring with zero-width bridges between the parts.
+Polygon clipConvex(const Polygon& subject, const Polygon& clip) {
+  std::vector<Point> output = subject.getVertices();
+  const std::vector<Point> edges = clip.getVertices();
+  double area = 0;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    area += Cross(edges[0], edges[i], edges[(i + 1) % edges.size()]);
+  }
+  double orientation = area < 0 ? -1 : 1;
+  for (size_t i = 0; i < edges.size() and !output.empty(); ++i) {
+    const Point& first = edges[i];
+    const Point& second = edges[(i + 1) % edges.size()];
+    std::vector<Point> input = std::move(output);
+    output.clear();
+    auto side = [&](const Point& point) {
+      return orientation * Orientation(first, second, point);
+    };
+    for (size_t j = 0; j < input.size(); ++j) {
+      const Point& previous = input[(j + input.size() - 1) % input.size()];
+      const Point& current = input[j];
+      double previous_side = side(previous);
+      double current_side = side(current);
+      // A vertex on the edge line is kept as it is rather than doubled by a crossing.
+      if ((previous_side < 0 and current_side > 0) or (previous_side > 0 and current_side < 0)) {
+        double t = previous_side / (previous_side - current_side);
+        output.emplace_back(previous.x + (current.x - previous.x) * t, previous.y + (current.y - previous.y) * t);
+      }
+      if (current_side >= 0) {
+        output.push_back(current);
+      }
+    }
   }
+  return Polygon(output);
 }
 
-void Polygon::scale(const Point& center, double coefficient) {
-  for (auto& point : points) {
-    Vector vector(center, point);
-    point.x = center.x + vector.x * coefficient;
-    point.y = center.y + vector.y * coefficient;
+enum class BooleanOperation {
+    Intersection,
+    Union,
+    Difference
+};
+
+namespace detail
+{
+  struct Segment {
+      Point first;
+      Point second;
+  };
+
+  std::vector<Point> CounterClockwise(const Polygon& polygon) {
+    std::vector<Point> points = polygon.getVertices();
+    double area = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+      area += Cross(points[0], points[i], points[(i + 1) % points.size()]);
+    }
+    if (area < 0) {
+      std::reverse(points.begin(), points.end());
+    }
+    return points;
+  }
+
+  // Records where every edge of one ring has to be cut to meet the other: at the endpoints of
+  // the other ring that touch it and at proper crossings. Edges are swept in order of their
+  // left end, and only edges with overlapping x-ranges are tested against each other.
+  void FindCuts(const std::vector<Point>* rings[2], std::vector<std::vector<Point>> cuts[2]) {
+    struct Item {
+        double min_x;
+        double max_x;
+        int ring;
+        size_t edge;
+    };
+    std::vector<Item> items;
+    for (int ring = 0; ring < 2; ++ring) {
+      const std::vector<Point>& points = *rings[ring];
+      cuts[ring].assign(points.size(), {});
+      for (size_t i = 0; i < points.size(); ++i) {
+        const Point& first = points[i];
+        const Point& second = points[(i + 1) % points.size()];
+        items.push_back({std::min(first.x, second.x), std::max(first.x, second.x), ring, i});
+      }
+    }
+    std::sort(items.begin(), items.end(), [](const Item& first, const Item& second) {
+      return first.min_x < second.min_x;
+    });
+    std::vector<Item> active[2];
+    for (const Item& item : items) {
+      for (auto& list : active) {
+        std::erase_if(list, [&item](const Item& other) {
+          return other.max_x < item.min_x - 1e-5;
+        });
+      }
+      const std::vector<Point>& own = *rings[item.ring];
+      const std::vector<Point>& foreign = *rings[1 - item.ring];
+      Point p1 = own[item.edge];
+      Point p2 = own[(item.edge + 1) % own.size()];
+      for (const Item& other : active[1 - item.ring]) {
+        Point q1 = foreign[other.edge];
+        Point q2 = foreign[(other.edge + 1) % foreign.size()];
+        std::vector<Point>& own_cuts = cuts[item.ring][item.edge];
+        std::vector<Point>& foreign_cuts = cuts[1 - item.ring][other.edge];
+        bool touching = false;
+        for (const Point& point : {q1, q2}) {
+          if (OnSegment(point, p1, p2)) {
+            own_cuts.push_back(point);
+            touching = true;
+          }
+        }
+        for (const Point& point : {p1, p2}) {
+          if (OnSegment(point, q1, q2)) {
+            foreign_cuts.push_back(point);
+            touching = true;
+          }
+        }
+        if (touching) {
+          continue;
+        }
+        double q1_side = Orientation(p1, p2, q1);
+        double q2_side = Orientation(p1, p2, q2);
+        double p1_side = Orientation(q1, q2, p1);
+        double p2_side = Orientation(q1, q2, p2);
+        if ((q1_side < 0) != (q2_side < 0) and (p1_side < 0) != (p2_side < 0) and
+            q1_side != 0 and q2_side != 0 and p1_side != 0 and p2_side != 0) {
+          double t = p1_side / (p1_side - p2_side);
+          Point crossing(p1.x + (p2.x - p1.x) * t, p1.y + (p2.y - p1.y) * t);
+          own_cuts.push_back(crossing);
+          foreign_cuts.push_back(crossing);
+        }
+      }
+      active[item.ring].push_back(item);
+    }
+  }
+
+  // Edges of the ring cut at the given points; a cut point becomes the shared end of two pieces.
+  std::vector<Segment> CutRing(const std::vector<Point>& points, std::vector<std::vector<Point>>& cuts) {
+    std::vector<Segment> pieces;
+    for (size_t i = 0; i < points.size(); ++i) {
+      const Point& first = points[i];
+      const Point& second = points[(i + 1) % points.size()];
+      Vector direction(first, second);
+      std::vector<Point>& stops = cuts[i];
+      std::sort(stops.begin(), stops.end(), [&](const Point& left, const Point& right) {
+        return direction.scalar_product(Vector(first, left)) < direction.scalar_product(Vector(first, right));
+      });
+      stops.push_back(second);
+      Point start = first;
+      for (const Point& stop : stops) {
+        if (stop.x != start.x or stop.y != start.y) {
+          pieces.push_back({start, stop});
+          start = stop;
+        }
+      }
+    }
+    return pieces;
+  }
+
+  // Joins directed edges into closed rings. Where several edges leave a vertex, the one reached
+  // first turning clockwise from the way back is taken, which keeps rings that only touch apart.
+  std::vector<std::vector<Point>> LinkRings(const std::vector<Segment>& edges) {
+    std::map<std::pair<double, double>, std::vector<size_t>> outgoing;
+    for (size_t i = 0; i < edges.size(); ++i) {
+      outgoing[{edges[i].first.x, edges[i].first.y}].push_back(i);
+    }
+    std::vector<bool> used(edges.size(), false);
+    std::vector<std::vector<Point>> rings;
+    for (size_t start = 0; start < edges.size(); ++start) {
+      if (used[start]) {
+        continue;
+      }
+      std::vector<Point> ring = {edges[start].first};
+      size_t current = start;
+      used[current] = true;
+      while (true) {
+        const Point& vertex = edges[current].second;
+        if (vertex.x == edges[start].first.x and vertex.y == edges[start].first.y) {
+          break;
+        }
+        ring.push_back(vertex);
+        double back = std::atan2(edges[current].first.y - vertex.y, edges[current].first.x - vertex.x);
+        size_t next = edges.size();
+        double best_turn = 0;
+        for (size_t candidate : outgoing[{vertex.x, vertex.y}]) {
+          if (used[candidate]) {
+            continue;
+          }
+          double turn = back - std::atan2(edges[candidate].second.y - vertex.y, edges[candidate].second.x - vertex.x);
+          turn = std::fmod(turn + 4 * M_PI, 2 * M_PI);
+          if (turn <= 0) {
+            turn += 2 * M_PI;
+          }
+          if (next == edges.size() or turn < best_turn) {
+            next = candidate;
+            best_turn = turn;
+          }
+        }
+        if (next == edges.size()) {
+          break;
+        }
+        used[next] = true;
+        current = next;
+      }
+      // Vertices left in the middle of a straight run by the cuts are dropped.
+      std::vector<Point> simple;
+      for (size_t i = 0; i < ring.size(); ++i) {
+        const Point& previous = ring[(i + ring.size() - 1) % ring.size()];
+        const Point& next = ring[(i + 1) % ring.size()];
+        double scale = Vector(previous, ring[i]).length() * Vector(ring[i], next).length();
+        if (std::fabs(Cross(previous, ring[i], next)) > 1e-12 * scale or
+            Vector(previous, ring[i]).scalar_product(Vector(ring[i], next)) < 0) {
+          simple.push_back(ring[i]);
+        }
+      }
+      if (simple.size() >= 3) {
+        rings.push_back(std::move(simple));
+      }
+    }
+    return rings;
   }
 }
 
+// Intersection, union or difference (first minus second) of two simple polygons. Both boundaries
+// are cut at their mutual intersections, every piece is kept or dropped by whether its midpoint
+// lies inside the other polygon, and the kept pieces are linked back into rings: outer
+// boundaries counterclockwise, holes clockwise. Holes are returned as polygons of their own,
+// not attached to the ring around them; signedArea() < 0 tells them apart, and the area of the
+// result is the sum of signedArea() over all of it. The intersection of two convex polygons
+// takes the Sutherland-Hodgman path.
+//
+// The cuts come from a sweep along x that tests each edge against the active edges of the other
+// polygon, so the cost is O((n + m) log(n + m) + k) for k pairs of edges with overlapping
+// x-ranges: O(n * m) in the worst case, e.g. two combs whose teeth all span the same x-range.
+std::vector<Polygon> combine(const Polygon& first, const Polygon& second, BooleanOperation operation) {
+  std::vector<Polygon> result;
+  if (operation == BooleanOperation::Intersection and first.verticesCount() >= 3 and second.verticesCount() >= 3 and
+      first.isConvex() and second.isConvex()) {
+    Polygon intersection = clipConvex(first, second);
+    std::vector<Point> ring = CounterClockwise(intersection);
+    double perimeter = intersection.perimeter();
+    // Polygons that only touch along an edge or at a vertex leave a flat ring.
+    if (ring.size() >= 3 and intersection.area() > 1e-12 * perimeter * perimeter) {
+      result.emplace_back(ring);
+    }
+    return result;
+  }
+  std::vector<Point> rings[2] = {CounterClockwise(first), CounterClockwise(second)};
+  const std::vector<Point>* ring_pointers[2] = {&rings[0], &rings[1]};
+  std::vector<std::vector<Point>> cuts[2];
+  FindCuts(ring_pointers, cuts);
+  std::vector<Segment> pieces[2] = {CutRing(rings[0], cuts[0]), CutRing(rings[1], cuts[1])};
+  Polygon outlines[2] = {Polygon(rings[0]), Polygon(rings[1])};
+  PreparedPolygon prepared[2] = {PreparedPolygon(outlines[0]), PreparedPolygon(outlines[1])};
+  // Pieces of the other ring with the same ends, 1 if in the same direction, -1 if opposite.
+  std::map<std::pair<std::pair<double, double>, std::pair<double, double>>, int> shared[2];
+  for (int ring = 0; ring < 2; ++ring) {
+    for (const Segment& piece : pieces[1 - ring]) {
+      shared[ring][{{piece.first.x, piece.first.y}, {piece.second.x, piece.second.y}}] = 1;
+      shared[ring][{{piece.second.x, piece.second.y}, {piece.first.x, piece.first.y}}] = -1;
+    }
+  }
+
+  std::vector<Segment> kept;
+  for (int ring = 0; ring < 2; ++ring) {
+    for (const Segment& piece : pieces[ring]) {
+      auto found = shared[ring].find({{piece.first.x, piece.first.y}, {piece.second.x, piece.second.y}});
+      int direction = found == shared[ring].end() ? 0 : found->second;
+      if (ring == 1 and direction != 0) {
+        continue;
+      }
+      bool keep = false;
+      bool inside = false;
+      if (direction == 0) {
+        Point middle((piece.first.x + piece.second.x) / 2, (piece.first.y + piece.second.y) / 2);
+        inside = prepared[1 - ring].containsPoint(middle);
+      }
+      switch (operation) {
+        case BooleanOperation::Intersection:
+          keep = direction == 1 or (direction == 0 and inside);
+          break;
+        case BooleanOperation::Union:
+          keep = direction == 1 or (direction == 0 and !inside);
+          break;
+        case BooleanOperation::Difference:
+          keep = direction == -1 or (direction == 0 and inside == (ring == 1));
+          break;
+      }
+      if (!keep) {
+        continue;
+      }
+      if (operation == BooleanOperation::Difference and ring == 1) {
+        kept.push_back({piece.second, piece.first});
+      } else {
+        kept.push_back(piece);
+      }
+    }
+  }
+  for (auto& ring : LinkRings(kept)) {
+    result.emplace_back(ring);
+  }
+  return result;
+}
+
 class Ellipse: public Shape {
 protected:
     Point focus1;
@@ -484,11 +1733,13 @@ public:
     bool isCongruentTo(const Shape& another) const override;
     bool isSimilarTo(const Shape& another) const override;
     bool containsPoint(const Point& point) const override;
+    Box boundingBox() const override;
 
     void rotate(const Point& center, double angle) override;
     void reflect(const Point& center) override;
     void reflect(const Line& axis) override;
     void scale(const Point& center, double coefficient) override;
+    void transform(const AffineTransform& transform) override;
 };
 
 bool Ellipse::operator==(const Shape& another) const {
@@ -546,40 +1797,48 @@ bool Ellipse::containsPoint(const Point& point) const {
   return sum_distance < distance or CompareDouble(distance, sum_distance);
 }
 
+// Half extents of an ellipse with semi-axes a along the unit vector u and b across it are
+// sqrt(a^2 u_x^2 + b^2 u_y^2) and sqrt(a^2 u_y^2 + b^2 u_x^2).
+Box Ellipse::boundingBox() const {
+  Vector axis(focus1, focus2);
+  double length = axis.length();
+  if (length > 0) {
+    axis *= 1 / length;
+  } else {
+    axis = Vector(Point(1, 0));
+  }
+  double big = big_axis();
+  double small = small_axis();
+  double half_width = std::sqrt(big * big * axis.x * axis.x + small * small * axis.y * axis.y);
+  double half_height = std::sqrt(big * big * axis.y * axis.y + small * small * axis.x * axis.x);
+  Point middle = center();
+  return Box(middle.x - half_width, middle.y - half_height, middle.x + half_width, middle.y + half_height);
+}
+
 void Ellipse::rotate(const Point& center, double angle) {
-  focus1.rotate(center, angle);
-  focus2.rotate(center, angle);
+  transform(AffineTransform::rotation(center, angle));
 }
 
 void Ellipse::reflect(const Point& center) {
-  focus1.reflect(center);
-  focus2.reflect(center);
+  transform(AffineTransform::reflection(center));
 }
 
 void Ellipse::reflect(const Line& axis) {
-  Vector normal;
-  normal.x = axis.point1.y - axis.point2.y;
-  normal.y = axis.point2.x - axis.point1.x;
-  double length_normal = normal.length();
-  normal.x /= length_normal;
-  normal.y /= length_normal;
-
-  double scalar1 = 2.0 * (normal.x * focus1.x + normal.y * focus1.y);
-  focus1.x -= scalar1 * normal.x;
-  focus1.y -= scalar1 * normal.y;
-  double scalar2 = 2.0 * (normal.x * focus2.x + normal.y * focus2.y);
-  focus2.x -= scalar2 * normal.x;
-  focus2.y -= scalar2 * normal.y;
+  transform(AffineTransform::reflection(axis));
 }
 
 void Ellipse::scale(const Point& center, double coefficient) {
-  Vector vector1(center, focus1);
-  focus1.x = center.x + vector1.x * coefficient;
-  focus1.y = center.y + vector1.y * coefficient;
-  Vector vector2(center, focus2);
-  focus2.x = center.x + vector2.x * coefficient;
-  focus2.y = center.y + vector2.y * coefficient;
-  distance *= coefficient;
+  transform(AffineTransform::scaling(center, coefficient));
+}
+
+// Only similarities map an ellipse to the ellipse with the mapped foci.
+void Ellipse::transform(const AffineTransform& transform) {
+  if (!transform.isSimilarity()) {
+    throw std::invalid_argument("Ellipse can only be transformed by a similarity");
+  }
+  focus1 = transform.apply(focus1);
+  focus2 = transform.apply(focus2);
+  distance *= std::sqrt(std::fabs(transform.determinant()));
 }
 
 class Circle: public Ellipse {
@@ -601,7 +1860,7 @@ public:
     Rectangle(Point point1, Point point3, double ratio);
 
     void swap(Rectangle& other) {
-      std::swap(points, other.points);
+      Polygon::swap(other);
     }
     Rectangle& operator=(Rectangle other) {
       swap(other);
@@ -609,13 +1868,15 @@ public:
     }
 
     Point center() const {
-      return Point((points[0].x + points[2].x) / 2.0,  (points[0].y + points[2].y) / 2.0);
+      const std::vector<Point>& vertices = current();
+      return Point((vertices[0].x + vertices[2].x) / 2.0,  (vertices[0].y + vertices[2].y) / 2.0);
     }
     std::pair<Line, Line> diagonals() const;
 };
 
 std::pair<Line, Line> Rectangle::diagonals() const {
-  return {Line(points[0], points[2]), Line(points[1], points[3])};
+  const std::vector<Point>& vertices = current();
+  return {Line(vertices[0], vertices[2]), Line(vertices[1], vertices[3])};
 }
 
 Rectangle::Rectangle(Point point1, Point point3, double ratio) {
@@ -628,9 +1889,10 @@ Rectangle::Rectangle(Point point1, Point point3, double ratio) {
   Vector vector(point1, point2);
   point2.x = point1.x + vector.x * coefficient;
   point2.y = point1.y + vector.y * coefficient;
-  points = {point1, point2, point3};
+  std::vector<Point> vertices = {point1, point2, point3};
   point2.reflect(Point((point1.x + point3.x) / 2, (point1.y + point3.y) / 2));
-  points.push_back(point2);
+  vertices.push_back(point2);
+  setVertices(std::move(vertices));
 }
 
 class Square: public Rectangle {
@@ -638,7 +1900,7 @@ public:
     Square(Point point1, Point point3) : Rectangle(point1, point3, 1.0) {}
 
     void swap(Square& other) {
-      std::swap(points, other.points);
+      Polygon::swap(other);
     }
     Square& operator=(Square other) {
       swap(other);
@@ -646,10 +1908,12 @@ public:
     }
 
     Circle circumscribedCircle() const {
-      return Circle(center(), Vector(points[0], center()).length());
+      const std::vector<Point>& vertices = current();
+      return Circle(center(), Vector(vertices[0], center()).length());
     }
     Circle inscribedCircle() const {
-      return Circle(center(), Vector(points[0], points[1]).length());
+      const std::vector<Point>& vertices = current();
+      return Circle(center(), Vector(vertices[0], vertices[1]).length());
     }
 };
 
@@ -658,7 +1922,7 @@ public:
     Triangle(Point point1, Point point2, Point point3): Polygon(point1, point2, point3) {}
 
     void swap(Triangle& other) {
-      std::swap(points, other.points);
+      Polygon::swap(other);
     }
     Triangle& operator=(Triangle other) {
       swap(other);
@@ -676,55 +1940,59 @@ public:
 };
 
 Circle Triangle::circumscribedCircle() const {
-  Vector site12(points[1], points[0]);
-  Vector site23(points[2], points[1]);
-  Vector site31(points[0], points[2]);
+  const std::vector<Point>& vertices = current();
+  Vector site12(vertices[1], vertices[0]);
+  Vector site23(vertices[2], vertices[1]);
+  Vector site31(vertices[0], vertices[2]);
 
   double length_normal = 2.0 * (site12.x * site31.y - site12.y * site31.x);
 
-  Vector point1(points[0]);
-  Vector point2(points[1]);
-  Vector point3(points[2]);
+  Vector point1(vertices[0]);
+  Vector point2(vertices[1]);
+  Vector point3(vertices[2]);
 
   double x_coefficient = site12.y * point3.length2() + site23.y * point1.length2() + site31.y * point2.length2();
   double y_coefficient = site12.x * point3.length2() + site23.x * point1.length2() + site31.x * point2.length2();
   Point center(-x_coefficient / length_normal, y_coefficient / length_normal);
 
-  double radius = Vector(center, points[0]).length();
+  double radius = Vector(center, vertices[0]).length();
   return Circle(center, radius);
 }
 
 Circle Triangle::inscribedCircle() const {
-  Vector site12(points[1], points[0]);
-  Vector site23(points[2], points[1]);
-  Vector site31(points[0], points[2]);
+  const std::vector<Point>& vertices = current();
+  Vector site12(vertices[1], vertices[0]);
+  Vector site23(vertices[2], vertices[1]);
+  Vector site31(vertices[0], vertices[2]);
   Point center;
 
-  center.x = (points[0].x * site23.length() + points[1].x * site31.length() + points[2].x * site12.length()) / Polygon::perimeter();
-  center.y = (points[0].y * site23.length() + points[1].y * site31.length() + points[2].y * site12.length()) / Polygon::perimeter();
+  center.x = (vertices[0].x * site23.length() + vertices[1].x * site31.length() + vertices[2].x * site12.length()) / Polygon::perimeter();
+  center.y = (vertices[0].y * site23.length() + vertices[1].y * site31.length() + vertices[2].y * site12.length()) / Polygon::perimeter();
   double radius = 2.0 * Polygon::area() / Polygon::perimeter();
   return Circle(center, radius);
 }
 
 Point Triangle::centroid() const {
-  Vector point1(points[0]);
-  Vector point2(points[1]);
-  Vector point3(points[2]);
+  const std::vector<Point>& vertices = current();
+  Vector point1(vertices[0]);
+  Vector point2(vertices[1]);
+  Vector point3(vertices[2]);
 
   Point centroid;
-  centroid.x = (points[0].x + points[1].x + points[2].x) / 3;
-  centroid.y = (points[0].y + points[1].y + points[2].y) / 3;
+  centroid.x = (vertices[0].x + vertices[1].x + vertices[2].x) / 3;
+  centroid.y = (vertices[0].y + vertices[1].y + vertices[2].y) / 3;
   return centroid;
 }
 
 Point Triangle::orthocenter() const {
-  Vector site23(points[1], points[2]);
-  Vector site31(points[0], points[2]);
+  const std::vector<Point>& vertices = current();
+  Vector site23(vertices[1], vertices[2]);
+  Vector site31(vertices[0], vertices[2]);
 
   Point first_point(site23.x, site31.x);
   Point second_point(site23.y, site31.y);
-  Point third_point(points[0].x * first_point.x + points[0].y * second_point.x,
-                    points[1].x * first_point.y + points[1].y * second_point.y);
+  Point third_point(vertices[0].x * first_point.x + vertices[0].y * second_point.x,
+                    vertices[1].x * first_point.y + vertices[1].y * second_point.y);
 
   double scalar12 = first_point.x * second_point.y - first_point.y * second_point.x;
   double scalar23 = third_point.x * second_point.y - third_point.y * second_point.x;
@@ -737,8 +2005,489 @@ Line Triangle::EulerLine() const {
 }
 
 Circle Triangle::ninePointsCircle() const {
-  Point center12((points[0].x + points[1].x) / 2, (points[0].y + points[1].y) / 2);
-  Point center23((points[1].x + points[2].x) / 2, (points[1].y + points[2].y) / 2);
-  Point center31((points[0].x + points[2].x) / 2, (points[0].y + points[2].y) / 2);
+  const std::vector<Point>& vertices = current();
+  Point center12((vertices[0].x + vertices[1].x) / 2, (vertices[0].y + vertices[1].y) / 2);
+  Point center23((vertices[1].x + vertices[2].x) / 2, (vertices[1].y + vertices[2].y) / 2);
+  Point center31((vertices[0].x + vertices[2].x) / 2, (vertices[0].y + vertices[2].y) / 2);
   return Triangle(center12, center23, center31).circumscribedCircle();
 }
+
+// Groups a collection of shapes into classes of equal, congruent or similar ones. Shapes are
+// sorted by a cheap invariant and only neighbours within its tolerance reach the exact
+// predicates; the classes are the connected components of the predicate.
+class ShapeIndex {
+public:
+    enum class Relation {
+        Equal,
+        Congruent,
+        Similar
+    };
+
+    explicit ShapeIndex(Relation relation = Relation::Equal): relation(relation) {}
+
+    // The shape is kept by reference and must outlive the index.
+    void add(const Shape& shape);
+    size_t size() const {
+      return entries.size();
+    }
+    // Classes as indices in the order of add, each sorted, ordered by their first index.
+    std::vector<std::vector<size_t>> groups(size_t threads = 1) const;
+private:
+    struct Entry {
+        const Shape* shape;
+        int kind;
+        size_t vertices;
+        double key;
+        double window;
+    };
+
+    Relation relation;
+    std::vector<Entry> entries;
+
+    bool related(const Shape& first, const Shape& second) const;
+    void join_run(const std::vector<size_t>& order, size_t begin, size_t end, std::vector<size_t>& parent) const;
+};
+
+// Polygons are keyed by perimeter, or by area / perimeter^2 up to similarity; ellipses by the
+// big axis, or by the axis ratio. Windows are wider than the predicates' own tolerance, the key
+// only has to keep related shapes next to each other.
+void ShapeIndex::add(const Shape& shape) {
+  Entry entry{&shape, 2, 0, 0, 0};
+  if (const auto* polygon = dynamic_cast<const Polygon*>(&shape)) {
+    entry.kind = 0;
+    entry.vertices = static_cast<size_t>(polygon->verticesCount());
+    double perimeter = polygon->perimeter();
+    if (relation == Relation::Similar) {
+      entry.key = perimeter > 0 ? polygon->area() / (perimeter * perimeter) : 0;
+      entry.window = 1e-3;
+    } else {
+      // Equal vertices may each move by 1e-5 per coordinate, so a side by up to 2 * sqrt(2) * 1e-5.
+      entry.key = perimeter;
+      entry.window = 2 * std::sqrt(2) * 1e-5 * static_cast<double>(entry.vertices + 1);
+    }
+  } else if (const auto* ellipse = dynamic_cast<const Ellipse*>(&shape)) {
+    entry.kind = 1;
+    if (relation == Relation::Similar) {
+      entry.key = ellipse->big_axis() > 0 ? ellipse->small_axis() / ellipse->big_axis() : 0;
+      entry.window = 1e-3;
+    } else {
+      entry.key = ellipse->big_axis();
+      entry.window = 2e-5;
+    }
+  }
+  entries.push_back(entry);
+}
+
+bool ShapeIndex::related(const Shape& first, const Shape& second) const {
+  switch (relation) {
+    case Relation::Equal:
+      return first == second;
+    case Relation::Congruent:
+      return first.isCongruentTo(second);
+    case Relation::Similar:
+      return first.isSimilarTo(second);
+  }
+  return false;
+}
+
+void ShapeIndex::join_run(const std::vector<size_t>& order, size_t begin, size_t end,
+                          std::vector<size_t>& parent) const {
+  auto find = [&parent](size_t index) {
+    while (parent[index] != index) {
+      parent[index] = parent[parent[index]];
+      index = parent[index];
+    }
+    return index;
+  };
+  for (size_t i = begin; i < end; ++i) {
+    const Entry& first = entries[order[i]];
+    for (size_t j = i + 1; j < end; ++j) {
+      const Entry& second = entries[order[j]];
+      if (second.key - first.key > std::max(first.window, second.window)) {
+        break;
+      }
+      size_t first_root = find(order[i]);
+      size_t second_root = find(order[j]);
+      if (first_root != second_root and related(*first.shape, *second.shape)) {
+        parent[std::max(first_root, second_root)] = std::min(first_root, second_root);
+      }
+    }
+  }
+}
+
+// Runs of the sorted order that no window bridges are independent, so they are spread over
+// threads; every shape belongs to exactly one run and is only touched by its thread.
+std::vector<std::vector<size_t>> ShapeIndex::groups(size_t threads) const {
+  std::vector<size_t> order(entries.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [this](size_t first, size_t second) {
+    const Entry& left = entries[first];
+    const Entry& right = entries[second];
+    if (left.kind != right.kind) {
+      return left.kind < right.kind;
+    }
+    if (left.vertices != right.vertices) {
+      return left.vertices < right.vertices;
+    }
+    return left.key < right.key;
+  });
+  std::vector<size_t> runs;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0) {
+      runs.push_back(0);
+      continue;
+    }
+    const Entry& previous = entries[order[i - 1]];
+    const Entry& current = entries[order[i]];
+    if (previous.kind != current.kind or previous.vertices != current.vertices or
+        current.key - previous.key > std::max(previous.window, current.window)) {
+      runs.push_back(i);
+    }
+  }
+  runs.push_back(order.size());
+
+  std::vector<size_t> parent(entries.size());
+  for (size_t i = 0; i < parent.size(); ++i) {
+    parent[i] = i;
+  }
+  size_t run_count = runs.size() - 1;
+  threads = std::max<size_t>(1, std::min(threads, run_count));
+  auto process = [&](size_t worker) {
+    for (size_t run = worker; run < run_count; run += threads) {
+      join_run(order, runs[run], runs[run + 1], parent);
+    }
+  };
+  std::vector<std::future<void>> workers;
+  for (size_t worker = 1; worker < threads; ++worker) {
+    workers.push_back(std::async(std::launch::async, process, worker));
+  }
+  process(0);
+  for (auto& worker : workers) {
+    worker.get();
+  }
+
+  std::vector<std::vector<size_t>> result;
+  std::vector<size_t> position(entries.size(), entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    size_t root = i;
+    while (parent[root] != root) {
+      root = parent[root];
+    }
+    if (position[root] == entries.size()) {
+      position[root] = result.size();
+      result.emplace_back();
+    }
+    result[position[root]].push_back(i);
+  }
+  return result;
+}
+
+// R-tree over shape bounding boxes. The constructor bulk-loads it with Sort-Tile-Recursive
+// packing; insert splits overflowing nodes along their longer side, remove drops empty nodes
+// without rebalancing.
+class ShapeTree {
+private:
+    static constexpr size_t kCapacity = 16;
+    static constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+    struct Node {
+        Box box;
+        size_t parent = kNone;
+        bool leaf = true;
+        std::vector<size_t> children;
+    };
+    struct Entry {
+        Box box;
+        const Shape* shape = nullptr;
+        size_t leaf = kNone;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<size_t> free_nodes;
+    std::vector<Entry> entries;
+    std::vector<size_t> free_entries;
+    std::unordered_map<const Shape*, size_t> positions;
+    size_t root = kNone;
+
+    const Box& child_box(const Node& node, size_t child) const {
+      return node.leaf ? entries[child].box : nodes[child].box;
+    }
+    void adopt(size_t node, size_t child);
+    size_t new_node(bool leaf);
+    size_t new_entry(const Shape& shape);
+    void refit(size_t node);
+    size_t pack(std::vector<size_t> items, bool leaf);
+    void split(size_t node);
+public:
+    ShapeTree() = default;
+    explicit ShapeTree(const std::vector<const Shape*>& shapes);
+
+    size_t size() const {
+      return positions.size();
+    }
+    // The shape is kept by pointer and must outlive the tree; its box is taken at insertion.
+    void insert(const Shape& shape);
+    bool remove(const Shape& shape);
+
+    std::vector<const Shape*> containing(const Point& point) const;
+    // Shapes whose bounding boxes intersect the box.
+    std::vector<const Shape*> intersecting(const Box& box) const;
+    // The count shapes with the nearest bounding boxes, closest first.
+    std::vector<const Shape*> nearest(const Point& point, size_t count) const;
+};
+
+ShapeTree::ShapeTree(const std::vector<const Shape*>& shapes) {
+  std::vector<size_t> items;
+  items.reserve(shapes.size());
+  for (const Shape* shape : shapes) {
+    items.push_back(new_entry(*shape));
+  }
+  if (!items.empty()) {
+    root = pack(std::move(items), true);
+  }
+}
+
+void ShapeTree::adopt(size_t node, size_t child) {
+  nodes[node].children.push_back(child);
+  nodes[node].box.extend(child_box(nodes[node], child));
+  if (nodes[node].leaf) {
+    entries[child].leaf = node;
+  } else {
+    nodes[child].parent = node;
+  }
+}
+
+size_t ShapeTree::new_node(bool leaf) {
+  size_t index = nodes.size();
+  if (!free_nodes.empty()) {
+    index = free_nodes.back();
+    free_nodes.pop_back();
+    nodes[index] = Node();
+  } else {
+    nodes.emplace_back();
+  }
+  nodes[index].leaf = leaf;
+  return index;
+}
+
+size_t ShapeTree::new_entry(const Shape& shape) {
+  size_t index = entries.size();
+  if (!free_entries.empty()) {
+    index = free_entries.back();
+    free_entries.pop_back();
+  } else {
+    entries.emplace_back();
+  }
+  entries[index] = Entry{shape.boundingBox(), &shape, kNone};
+  positions[&shape] = index;
+  return index;
+}
+
+void ShapeTree::refit(size_t node) {
+  nodes[node].box = Box();
+  for (size_t child : nodes[node].children) {
+    nodes[node].box.extend(child_box(nodes[node], child));
+  }
+}
+
+// Sort-Tile-Recursive: sort by x, cut into sqrt(pages) vertical slices, sort every slice by y
+// and fill pages of kCapacity; repeat on the pages until one is left.
+size_t ShapeTree::pack(std::vector<size_t> items, bool leaf) {
+  while (true) {
+    auto center = [this, leaf](size_t item) {
+      return leaf ? entries[item].box.center() : nodes[item].box.center();
+    };
+    size_t pages = (items.size() + kCapacity - 1) / kCapacity;
+    size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(pages))));
+    size_t slice_size = slices * kCapacity;
+    std::sort(items.begin(), items.end(), [&center](size_t first, size_t second) {
+      return center(first).x < center(second).x;
+    });
+    std::vector<size_t> parents;
+    for (size_t begin = 0; begin < items.size(); begin += slice_size) {
+      auto slice_end = items.begin() + static_cast<std::ptrdiff_t>(std::min(begin + slice_size, items.size()));
+      std::sort(items.begin() + static_cast<std::ptrdiff_t>(begin), slice_end, [&center](size_t first, size_t second) {
+        return center(first).y < center(second).y;
+      });
+      for (size_t page = begin; page < std::min(begin + slice_size, items.size()); page += kCapacity) {
+        size_t node = new_node(leaf);
+        for (size_t i = page; i < std::min(page + kCapacity, items.size()); ++i) {
+          adopt(node, items[i]);
+        }
+        parents.push_back(node);
+      }
+    }
+    if (parents.size() == 1) {
+      return parents[0];
+    }
+    items = std::move(parents);
+    leaf = false;
+  }
+}
+
+void ShapeTree::split(size_t node) {
+  while (nodes[node].children.size() > kCapacity) {
+    Box box = nodes[node].box;
+    bool by_x = box.max_x - box.min_x >= box.max_y - box.min_y;
+    std::vector<size_t> children = std::move(nodes[node].children);
+    std::sort(children.begin(), children.end(), [&](size_t first, size_t second) {
+      Point first_center = child_box(nodes[node], first).center();
+      Point second_center = child_box(nodes[node], second).center();
+      return by_x ? first_center.x < second_center.x : first_center.y < second_center.y;
+    });
+    size_t sibling = new_node(nodes[node].leaf);
+    nodes[node].children.clear();
+    nodes[node].box = Box();
+    for (size_t i = 0; i < children.size(); ++i) {
+      adopt(i < children.size() / 2 ? node : sibling, children[i]);
+    }
+    size_t parent = nodes[node].parent;
+    if (parent == kNone) {
+      root = new_node(false);
+      adopt(root, node);
+      adopt(root, sibling);
+      return;
+    }
+    adopt(parent, sibling);
+    node = parent;
+  }
+}
+
+void ShapeTree::insert(const Shape& shape) {
+  if (positions.count(&shape) != 0) {
+    return;
+  }
+  size_t entry = new_entry(shape);
+  const Box& box = entries[entry].box;
+  if (root == kNone) {
+    root = new_node(true);
+  }
+  size_t node = root;
+  while (!nodes[node].leaf) {
+    nodes[node].box.extend(box);
+    size_t best = kNone;
+    double best_growth = 0;
+    double best_area = 0;
+    for (size_t child : nodes[node].children) {
+      Box grown = nodes[child].box;
+      grown.extend(box);
+      double area = nodes[child].box.area();
+      double growth = grown.area() - area;
+      if (best == kNone or growth < best_growth or (growth == best_growth and area < best_area)) {
+        best = child;
+        best_growth = growth;
+        best_area = area;
+      }
+    }
+    node = best;
+  }
+  adopt(node, entry);
+  split(node);
+}
+
+bool ShapeTree::remove(const Shape& shape) {
+  auto position = positions.find(&shape);
+  if (position == positions.end()) {
+    return false;
+  }
+  size_t entry = position->second;
+  positions.erase(position);
+  size_t node = entries[entry].leaf;
+  std::erase(nodes[node].children, entry);
+  entries[entry] = Entry();
+  free_entries.push_back(entry);
+  if (positions.empty()) {
+    *this = ShapeTree();
+    return true;
+  }
+  while (node != kNone) {
+    size_t parent = nodes[node].parent;
+    if (nodes[node].children.empty() and parent != kNone) {
+      std::erase(nodes[parent].children, node);
+      free_nodes.push_back(node);
+    } else {
+      refit(node);
+    }
+    node = parent;
+  }
+  while (!nodes[root].leaf and nodes[root].children.size() == 1) {
+    size_t child = nodes[root].children[0];
+    free_nodes.push_back(root);
+    root = child;
+    nodes[root].parent = kNone;
+  }
+  return true;
+}
+
+std::vector<const Shape*> ShapeTree::containing(const Point& point) const {
+  std::vector<const Shape*> result;
+  if (root == kNone) {
+    return result;
+  }
+  std::vector<size_t> stack = {root};
+  while (!stack.empty()) {
+    const Node& node = nodes[stack.back()];
+    stack.pop_back();
+    for (size_t child : node.children) {
+      if (!child_box(node, child).contains(point)) {
+        continue;
+      }
+      if (!node.leaf) {
+        stack.push_back(child);
+      } else if (entries[child].shape->containsPoint(point)) {
+        result.push_back(entries[child].shape);
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<const Shape*> ShapeTree::intersecting(const Box& box) const {
+  std::vector<const Shape*> result;
+  if (root == kNone) {
+    return result;
+  }
+  std::vector<size_t> stack = {root};
+  while (!stack.empty()) {
+    const Node& node = nodes[stack.back()];
+    stack.pop_back();
+    for (size_t child : node.children) {
+      if (!child_box(node, child).intersects(box)) {
+        continue;
+      }
+      if (node.leaf) {
+        result.push_back(entries[child].shape);
+      } else {
+        stack.push_back(child);
+      }
+    }
+  }
+  return result;
+}
+
+// Best-first search: nodes and entries share one queue ordered by box distance, so an entry
+// leaves the queue only when nothing unexplored can be closer.
+std::vector<const Shape*> ShapeTree::nearest(const Point& point, size_t count) const {
+  std::vector<const Shape*> result;
+  if (root == kNone or count == 0) {
+    return result;
+  }
+  using Item = std::pair<double, std::pair<bool, size_t>>;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+  queue.push({nodes[root].box.distance2(point), {false, root}});
+  while (!queue.empty() and result.size() < count) {
+    auto item = queue.top().second;
+    queue.pop();
+    if (item.first) {
+      result.push_back(entries[item.second].shape);
+      continue;
+    }
+    const Node& node = nodes[item.second];
+    for (size_t child : node.children) {
+      queue.push({child_box(node, child).distance2(point), {node.leaf, child}});
+    }
+  }
+  return result;
+}
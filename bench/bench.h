@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// A small runner in the spirit of Google Benchmark: each case is repeated until it has run for
+// kMinimumTime, then reported as ns/op, limbs (or elements) per second and allocations per op.
+namespace bench
+{
+  inline std::atomic<size_t> allocations = 0;
+  inline std::string_view filter;
+
+  // Forwards to new/delete and counts every allocation; installed through
+  // BigInteger::setMemoryResource it sees all limb storage made on the calling thread.
+  class CountingResource: public std::pmr::memory_resource {
+  private:
+      void* do_allocate(size_t bytes, size_t alignment) override {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+      }
+      void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+      }
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+      }
+  };
+
+  struct Result {
+      double nanoseconds = 0;
+      double allocations = 0;
+  };
+
+  template <typename Value>
+  inline void keep(const Value& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+
+  inline void header() {
+    std::printf("%-40s %14s %14s %12s\n", "benchmark", "ns/op", "items/s", "allocs/op");
+  }
+
+  // Runs body until kMinimumTime has passed; items is the amount of work in one call (limbs,
+  // vertices, shapes) and only feeds the throughput column.
+  template <typename Body>
+  Result run(const std::string& name, double items, Body&& body) {
+    constexpr auto kMinimumTime = std::chrono::milliseconds(200);
+    if (name.find(filter) == std::string::npos) {
+      return {};
+    }
+    body();
+    size_t iterations = 1;
+    while (true) {
+      size_t before = allocations.load(std::memory_order_relaxed);
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < iterations; ++i) {
+        body();
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed >= kMinimumTime or iterations >= (size_t(1) << 30)) {
+        Result result;
+        result.nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+        result.allocations = static_cast<double>(allocations.load(std::memory_order_relaxed) - before) /
+                             static_cast<double>(iterations);
+        std::printf("%-40s %14.1f %14.4g %12.2f\n", name.c_str(), result.nanoseconds,
+                    items * 1e9 / result.nanoseconds, result.allocations);
+        return result;
+      }
+      iterations *= 2;
+    }
+  }
+}
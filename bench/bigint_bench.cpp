@@ -0,0 +1,220 @@
+#include "../BigInteger+Rational.cpp"
+#include "bench.h"
+
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#ifdef BENCH_WITH_GMP
+#include <gmpxx.h>
+#endif
+
+// Usage: bigint_bench [filter]; only the cases whose name contains filter are run. Operands are
+// random numbers of the given number of base-1e9 limbs, built once outside the timed loop.
+namespace
+{
+  std::mt19937_64 random_engine(2024);
+
+  std::string random_digits(size_t limbs) {
+    std::string digits(1, static_cast<char>('1' + random_engine() % 9));
+    for (size_t i = 1; i < 9 * limbs; ++i) {
+      digits.push_back(static_cast<char>('0' + random_engine() % 10));
+    }
+    return digits;
+  }
+
+  std::string name(const char* operation, size_t limbs) {
+    return std::string(operation) + "/" + std::to_string(limbs);
+  }
+
+#ifdef BENCH_WITH_GMP
+  // GMP's allocator hooks feed the same counter, so allocs/op compares like with like.
+  void* gmp_allocate(size_t bytes) {
+    bench::allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(bytes);
+  }
+
+  void* gmp_reallocate(void* pointer, size_t, size_t bytes) {
+    bench::allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::realloc(pointer, bytes);
+  }
+
+  void gmp_free(void* pointer, size_t) {
+    std::free(pointer);
+  }
+
+  // Runs the GMP counterpart of the case just measured and prints how far behind we are.
+  template <typename Body>
+  void versus_gmp(const std::string& label, const bench::Result& ours, double items, Body&& body) {
+    if (ours.nanoseconds == 0) {
+      return;
+    }
+    bench::Result theirs = bench::run("gmp/" + label, items, body);
+    std::printf("%-40s %14.2fx\n", ("ratio/" + label).c_str(), ours.nanoseconds / theirs.nanoseconds);
+  }
+#define VERSUS_GMP(label, items, body) versus_gmp(label, ours, items, body)
+#else
+#define VERSUS_GMP(label, items, body) (void)ours
+#endif
+
+  void integer_cases(size_t limbs) {
+    std::string first_digits = random_digits(limbs);
+    std::string second_digits = random_digits(limbs);
+    std::string wide_digits = random_digits(2 * limbs);
+    BigInteger first(first_digits);
+    BigInteger second(second_digits);
+    BigInteger wide(wide_digits);
+    BigInteger negative = -second;
+    double items = static_cast<double>(limbs);
+    bench::Result ours;
+#ifdef BENCH_WITH_GMP
+    mpz_class gmp_first(first_digits);
+    mpz_class gmp_second(second_digits);
+    mpz_class gmp_wide(wide_digits);
+#endif
+
+    ours = bench::run(name("add", limbs), items, [&] { bench::keep(first + second); });
+    VERSUS_GMP(name("add", limbs), items, [&] { bench::keep(mpz_class(gmp_first + gmp_second)); });
+    ours = bench::run(name("subtract", limbs), items, [&] { bench::keep(first - second); });
+    VERSUS_GMP(name("subtract", limbs), items, [&] { bench::keep(mpz_class(gmp_first - gmp_second)); });
+    bench::run(name("add_mixed_sign", limbs), items, [&] { bench::keep(first + negative); });
+    ours = bench::run(name("multiply", limbs), items, [&] { bench::keep(first * second); });
+    VERSUS_GMP(name("multiply", limbs), items, [&] { bench::keep(mpz_class(gmp_first * gmp_second)); });
+    ours = bench::run(name("divide", limbs), items, [&] { bench::keep(wide / second); });
+    VERSUS_GMP(name("divide", limbs), items, [&] { bench::keep(mpz_class(gmp_wide / gmp_second)); });
+    ours = bench::run(name("modulo", limbs), items, [&] { bench::keep(wide % second); });
+    VERSUS_GMP(name("modulo", limbs), items, [&] { bench::keep(mpz_class(gmp_wide % gmp_second)); });
+    bench::run(name("compare", limbs), items, [&] { bench::keep(first < second); });
+    bench::run(name("equal", limbs), items, [&] { bench::keep(first == second); });
+    bench::run(name("negate", limbs), items, [&] { bench::keep(-first); });
+    bench::run(name("increment", limbs), items, [&] {
+      BigInteger copy = first;
+      bench::keep(++copy);
+    });
+    ours = bench::run(name("shift_left", limbs), items, [&] { bench::keep(first << 100); });
+    VERSUS_GMP(name("shift_left", limbs), items, [&] { bench::keep(mpz_class(gmp_first << 100)); });
+    ours = bench::run(name("shift_right", limbs), items, [&] { bench::keep(first >> 100); });
+    VERSUS_GMP(name("shift_right", limbs), items, [&] { bench::keep(mpz_class(gmp_first >> 100)); });
+    ours = bench::run(name("and", limbs), items, [&] { bench::keep(first & second); });
+    VERSUS_GMP(name("and", limbs), items, [&] { bench::keep(mpz_class(gmp_first & gmp_second)); });
+    bench::run(name("or", limbs), items, [&] { bench::keep(first | second); });
+    bench::run(name("xor", limbs), items, [&] { bench::keep(first ^ second); });
+    bench::run(name("not", limbs), items, [&] { bench::keep(~first); });
+    bench::run(name("bit_length", limbs), items, [&] { bench::keep(first.bitLength()); });
+    bench::run(name("test_bit", limbs), items, [&] { bench::keep(first.testBit(64)); });
+    ours = bench::run(name("to_string", limbs), items, [&] { bench::keep(first.toString()); });
+    VERSUS_GMP(name("to_string", limbs), items, [&] { bench::keep(gmp_first.get_str()); });
+    ours = bench::run(name("from_string", limbs), items, [&] { bench::keep(BigInteger(first_digits)); });
+    VERSUS_GMP(name("from_string", limbs), items, [&] { bench::keep(mpz_class(first_digits)); });
+    if (limbs <= 512) {
+      ours = bench::run(name("gcd", limbs), items, [&] { bench::keep(gcd(first, second)); });
+      VERSUS_GMP(name("gcd", limbs), items, [&] { bench::keep(mpz_class(gcd(gmp_first, gmp_second))); });
+      ours = bench::run(name("isqrt", limbs), items, [&] { bench::keep(isqrt(wide)); });
+      VERSUS_GMP(name("isqrt", limbs), items, [&] { bench::keep(mpz_class(sqrt(gmp_wide))); });
+    }
+  }
+
+  // f(n) = f(n / 2) + f(n / 3) + f(n / 4) with f(n) = n below 12, memoized in a BigInteger-keyed
+  // hash map: thousands of distinct arguments, each hashed and compared several times.
+  BigInteger memoized(const BigInteger& number, std::unordered_map<BigInteger, BigInteger>& cache) {
+    if (number < 12) {
+      return number;
+    }
+    auto found = cache.find(number);
+    if (found != cache.end()) {
+      return found->second;
+    }
+    BigInteger result = memoized(number / 2, cache) + memoized(number / 3, cache) + memoized(number / 4, cache);
+    cache.emplace(number, result);
+    return result;
+  }
+
+  void hash_cases() {
+    for (size_t limbs : {1, 8, 64}) {
+      BigInteger number(random_digits(limbs));
+      if (limbs <= 8) {
+        std::unordered_map<BigInteger, BigInteger> cache;
+        memoized(number, cache);
+        bench::run(name("memoized_recursion", limbs), static_cast<double>(cache.size()), [&] {
+          std::unordered_map<BigInteger, BigInteger> fresh;
+          bench::keep(memoized(number, fresh));
+        });
+      }
+      bench::run(name("hash", limbs), static_cast<double>(limbs), [&] { bench::keep(std::hash<BigInteger>()(number)); });
+      Rational fraction = Rational(number) / Rational(BigInteger(random_digits(limbs)));
+      bench::run(name("rational_hash", limbs), static_cast<double>(limbs), [&] {
+        Rational copy = fraction;
+        bench::keep(std::hash<Rational>()(copy));
+      });
+    }
+  }
+
+  // One multiplication of two million-digit numbers on 1, 2, 4, ... threads up to the hardware
+  // count. Allocations made by the worker threads go to their own resource and are not counted.
+  void thread_scaling_cases() {
+    constexpr size_t kLimbs = 1000000 / 9 + 1;
+    BigInteger first(random_digits(kLimbs));
+    BigInteger second(random_digits(kLimbs));
+    size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    for (size_t threads = 1;; threads = std::min(2 * threads, hardware)) {
+      BigInteger::setMultiplicationThreads(threads);
+      bench::run(name("multiply_threads", threads), static_cast<double>(kLimbs), [&] { bench::keep(first * second); });
+      if (threads == hardware) {
+        break;
+      }
+    }
+    BigInteger::setMultiplicationThreads(1);
+  }
+
+  void rational_cases(size_t limbs) {
+    std::string digits[4] = {random_digits(limbs), random_digits(limbs), random_digits(limbs), random_digits(limbs)};
+    Rational first = Rational(BigInteger(digits[0])) / Rational(BigInteger(digits[1]));
+    Rational second = Rational(BigInteger(digits[2])) / Rational(BigInteger(digits[3]));
+    double items = static_cast<double>(limbs);
+    bench::Result ours;
+#ifdef BENCH_WITH_GMP
+    mpq_class gmp_first{mpz_class(digits[0]), mpz_class(digits[1])};
+    mpq_class gmp_second{mpz_class(digits[2]), mpz_class(digits[3])};
+    gmp_first.canonicalize();
+    gmp_second.canonicalize();
+#endif
+
+    ours = bench::run(name("rational_add", limbs), items, [&] { bench::keep(first + second); });
+    VERSUS_GMP(name("rational_add", limbs), items, [&] { bench::keep(mpq_class(gmp_first + gmp_second)); });
+    ours = bench::run(name("rational_subtract", limbs), items, [&] { bench::keep(first - second); });
+    VERSUS_GMP(name("rational_subtract", limbs), items, [&] { bench::keep(mpq_class(gmp_first - gmp_second)); });
+    ours = bench::run(name("rational_multiply", limbs), items, [&] { bench::keep(first * second); });
+    VERSUS_GMP(name("rational_multiply", limbs), items, [&] { bench::keep(mpq_class(gmp_first * gmp_second)); });
+    ours = bench::run(name("rational_divide", limbs), items, [&] { bench::keep(first / second); });
+    VERSUS_GMP(name("rational_divide", limbs), items, [&] { bench::keep(mpq_class(gmp_first / gmp_second)); });
+    ours = bench::run(name("rational_compare", limbs), items, [&] { bench::keep(first < second); });
+    VERSUS_GMP(name("rational_compare", limbs), items, [&] { bench::keep(gmp_first < gmp_second); });
+    bench::run(name("rational_equal", limbs), items, [&] { bench::keep(first == second); });
+    bench::run(name("rational_negate", limbs), items, [&] { bench::keep(-first); });
+    ours = bench::run(name("rational_to_double", limbs), items, [&] { bench::keep(static_cast<double>(first)); });
+    VERSUS_GMP(name("rational_to_double", limbs), items, [&] { bench::keep(gmp_first.get_d()); });
+    bench::run(name("rational_as_decimal", limbs), items, [&] { bench::keep(first.asDecimal(50)); });
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    bench::filter = argv[1];
+  }
+  bench::CountingResource counting;
+  BigInteger::setMemoryResource(&counting);
+#ifdef BENCH_WITH_GMP
+  mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_free);
+#endif
+  bench::header();
+  for (size_t limbs : {1, 8, 64, 512, 4096}) {
+    integer_cases(limbs);
+  }
+  for (size_t limbs : {1, 8, 64, 512}) {
+    rational_cases(limbs);
+  }
+  hash_cases();
+  thread_scaling_cases();
+  BigInteger::setMemoryResource(std::pmr::new_delete_resource());
+}
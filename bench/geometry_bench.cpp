@@ -0,0 +1,169 @@
+#include "../Geometry.cpp"
+#include "bench.h"
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string_view>
+#include <thread>
+
+// Geometry allocates through the global heap, so allocations are counted by replacing
+// operator new. Usage: geometry_bench [filter] [--full]; --full runs the sizes from the
+// original requests instead of ones that finish in seconds.
+void* operator new(size_t bytes) {
+  bench::allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(bytes == 0 ? 1 : bytes)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+namespace
+{
+  std::mt19937_64 random_engine(2024);
+  bool full = false;
+
+  std::string name(const char* operation, size_t size) {
+    return std::string(operation) + "/" + std::to_string(size);
+  }
+
+  std::vector<Point> random_points(size_t count, double low, double high) {
+    std::uniform_real_distribution<double> coordinate(low, high);
+    std::vector<Point> result(count);
+    for (auto& point : result) {
+      point = Point(coordinate(random_engine), coordinate(random_engine));
+    }
+    return result;
+  }
+
+  // n vertices on the unit circle, counterclockwise; with dent every other one is pulled in,
+  // which keeps the polygon simple but not convex.
+  std::vector<Point> circle_vertices(size_t count, bool dent) {
+    std::vector<Point> result(count);
+    for (size_t i = 0; i < count; ++i) {
+      double angle = 2 * M_PI * static_cast<double>(i) / static_cast<double>(count);
+      double radius = dent and i % 2 == 1 ? 0.9 : 1.0;
+      result[i] = Point(radius * std::cos(angle), radius * std::sin(angle));
+    }
+    return result;
+  }
+
+  void convex_cases() {
+    std::vector<size_t> sizes = {1000, 100000};
+    if (full) {
+      sizes.push_back(1000000);
+    }
+    std::vector<Point> queries = random_points(4096, -1.1, 1.1);
+    for (size_t size : sizes) {
+      std::vector<Point> vertices = circle_vertices(size, false);
+      Polygon convex(vertices);
+      std::vector<Point> dented = circle_vertices(size, true);
+      Polygon concave(dented);
+      size_t next = 0;
+      bench::run(name("convex_contains", size), 1, [&] {
+        bench::keep(convex.containsPoint(queries[next++ % queries.size()]));
+      });
+      bench::run(name("concave_contains", size), 1, [&] {
+        bench::keep(concave.containsPoint(queries[next++ % queries.size()]));
+      });
+      bench::run(name("is_convex", size), static_cast<double>(size), [&] {
+        convex.setVertices(vertices);
+        bench::keep(convex.isConvex());
+      });
+    }
+  }
+
+  // Circles and triangles scattered over a square whose side grows with the count, so the
+  // number of shapes covering a point stays about constant.
+  void shape_tree_cases() {
+    size_t size = full ? 10000000 : 100000;
+    double side = std::sqrt(static_cast<double>(size));
+    std::vector<Point> centers = random_points(size, 0, side);
+    std::vector<std::unique_ptr<Shape>> shapes;
+    shapes.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      const Point& center = centers[i];
+      if (i % 2 == 0) {
+        shapes.push_back(std::make_unique<Circle>(center, 0.5));
+      } else {
+        shapes.push_back(std::make_unique<Polygon>(center, Point(center.x + 1, center.y), Point(center.x, center.y + 1)));
+      }
+    }
+    std::vector<const Shape*> pointers;
+    pointers.reserve(size);
+    for (const auto& shape : shapes) {
+      pointers.push_back(shape.get());
+    }
+    std::vector<Point> queries = random_points(4096, 0, side);
+    size_t next = 0;
+
+    bench::run(name("shape_tree_build", size), static_cast<double>(size), [&] { ShapeTree tree(pointers); });
+    ShapeTree tree(pointers);
+    bench::run(name("shape_tree_containing", size), 1, [&] {
+      bench::keep(tree.containing(queries[next++ % queries.size()]));
+    });
+    bench::run(name("shape_tree_intersecting", size), 1, [&] {
+      const Point& corner = queries[next++ % queries.size()];
+      bench::keep(tree.intersecting(Box(corner.x, corner.y, corner.x + 2, corner.y + 2)));
+    });
+    bench::run(name("shape_tree_nearest_10", size), 1, [&] {
+      bench::keep(tree.nearest(queries[next++ % queries.size()], 10));
+    });
+    bench::run(name("shape_tree_insert_remove", size), 1, [&] {
+      const Shape& shape = *shapes[next++ % shapes.size()];
+      tree.remove(shape);
+      tree.insert(shape);
+    });
+    bench::run(name("linear_scan_containing", size), static_cast<double>(size), [&] {
+      const Point& query = queries[next++ % queries.size()];
+      size_t count = 0;
+      for (const auto& shape : shapes) {
+        count += shape->containsPoint(query);
+      }
+      bench::keep(count);
+    });
+  }
+
+  // Hulls of uniform random points on 1, 2, 4, ... threads, with the tolerant and the exact
+  // orientation predicate.
+  void hull_cases() {
+    size_t size = full ? 100000000 : 1000000;
+    std::vector<Point> points = random_points(size, -1, 1);
+    size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    for (bool exact : {false, true}) {
+      setExactPredicates(exact);
+      for (size_t threads = 1;; threads = std::min(2 * threads, hardware)) {
+        std::string label = std::string(exact ? "convex_hull_exact" : "convex_hull") + "/" + std::to_string(size) +
+                            "/threads:" + std::to_string(threads);
+        bench::run(label, static_cast<double>(size), [&] { bench::keep(convexHull(points, threads)); });
+        if (threads == hardware) {
+          break;
+        }
+      }
+    }
+    setExactPredicates(false);
+  }
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::string_view(argv[i]) == "--full") {
+      full = true;
+    } else {
+      bench::filter = argv[i];
+    }
+  }
+  bench::header();
+  convex_cases();
+  shape_tree_cases();
+  hull_cases();
+}
@@ -0,0 +1,56 @@
+#include "../BigInteger+Rational.cpp"
+#include "check.h"
+
+#include <cmath>
+
+namespace
+{
+  void test_iroot() {
+    CHECK(iroot(BigInteger(1000), 3) == 10);
+    CHECK(iroot(BigInteger(999), 3) == 9);
+    CHECK(iroot(BigInteger(-1000), 3) == -10);
+    CHECK(iroot(BigInteger(12345), 1) == 12345);
+    CHECK(iroot(BigInteger(0), 5) == 0);
+    CHECK(iroot(power(BigInteger(7), 100), 100) == 7);
+    CHECK(iroot(power(BigInteger(7), 100) - 1, 100) == 6);
+    CHECK_THROWS(iroot(BigInteger(8), 0), std::domain_error);
+    CHECK_THROWS(iroot(BigInteger(-8), 0), std::domain_error);
+    CHECK_THROWS(iroot(BigInteger(0), 0), std::domain_error);
+    CHECK_THROWS(iroot(BigInteger(-16), 4), std::domain_error);
+  }
+
+  // Halfway between two neighbouring doubles, nudged by one part in 2^200 or not at all.
+  Rational midpoint(double value, int nudge) {
+    Rational half = (Rational(value) + Rational(std::nextafter(value, INFINITY))) / Rational(2);
+    return half + Rational(nudge) / Rational(power(2, 1300));
+  }
+
+  void test_rational_to_double() {
+    CHECK(static_cast<double>(Rational(1) / Rational(3)) == 1.0 / 3);
+    CHECK(static_cast<double>(Rational(-2) / Rational(7)) == -2.0 / 7);
+    CHECK(static_cast<double>(Rational(0.1)) == 0.1);
+    // Ties go to the even neighbour, anything past the tie to the far one.
+    CHECK(static_cast<double>(midpoint(1.0, 0)) == 1.0);
+    CHECK(static_cast<double>(midpoint(1.0, 1)) == std::nextafter(1.0, 2.0));
+    CHECK(static_cast<double>(midpoint(std::nextafter(1.0, 2.0), 0)) == std::nextafter(std::nextafter(1.0, 2.0), 2.0));
+    CHECK(static_cast<double>(midpoint(std::nextafter(1.0, 2.0), -1)) == std::nextafter(1.0, 2.0));
+    // Overflow, subnormals and underflow.
+    CHECK(static_cast<double>(Rational(power(2, 1023))) == std::ldexp(1.0, 1023));
+    CHECK(static_cast<double>(Rational(power(2, 1024))) == INFINITY);
+    CHECK(static_cast<double>(-Rational(power(2, 5000))) == -INFINITY);
+    CHECK(static_cast<double>(Rational(3) / Rational(power(2, 1074))) == 3 * std::ldexp(1.0, -1074));
+    CHECK(static_cast<double>(Rational(1) / Rational(power(2, 1075))) == 0);
+    CHECK(static_cast<double>(Rational(power(2, 300) + 1) / Rational(power(2, 1375))) == std::ldexp(1.0, -1074));
+    CHECK(static_cast<double>(Rational(1) / Rational(power(2, 5000))) == 0);
+    // Huge operands with a quotient near one.
+    BigInteger large = power(BigInteger(3), 20000);
+    CHECK(static_cast<double>(Rational(large + 1) / Rational(large)) == 1.0);
+    CHECK(static_cast<double>(Rational(large * 5) / Rational(large * 2 + 1)) == 2.5);
+  }
+}
+
+int main() {
+  test_iroot();
+  test_rational_to_double();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Unlike assert, stays on in release builds and reports every failure before exiting.
+inline int failures = 0;
+
+#define CHECK(condition)                                                                   \
+  do {                                                                                     \
+    if (!(condition)) {                                                                    \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n";      \
+      ++failures;                                                                          \
+    }                                                                                      \
+  } while (false)
+
+#define CHECK_THROWS(expression, exception)                                                \
+  do {                                                                                     \
+    bool thrown = false;                                                                   \
+    try {                                                                                  \
+      (void)(expression);                                                                  \
+    } catch (const exception&) {                                                           \
+      thrown = true;                                                                       \
+    }                                                                                      \
+    if (!thrown) {                                                                         \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": " #expression " did not throw\n";     \
+      ++failures;                                                                          \
+    }                                                                                      \
+  } while (false)
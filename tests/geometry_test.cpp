@@ -0,0 +1,76 @@
+#include "../Geometry.cpp"
+#include "check.h"
+
+namespace
+{
+  // Regular heptagons with every vertex moved by a few 1e-6, so all sides and corners agree to
+  // within the 1e-5 tolerance but not exactly; the second one starts at another vertex.
+  void test_congruence_within_tolerance() {
+    std::vector<Point> first = {
+        Point(0.99999859280475312, 2.1054574486347294e-06), Point(0.62349119522707253, 0.78182891446435043),
+        Point(-0.22252472696019329, 0.97492788631667138), Point(-0.90096716812505107, 0.43388156607762335),
+        Point(-0.90097266177941426, -0.4338853444970357), Point(-0.22251814836387993, -0.97493145315946517),
+        Point(0.62348896811511989, -0.78182752514480069)};
+    std::vector<Point> second = {
+        Point(-0.90096351133192232, 0.43388229811887713), Point(-0.90097176013973068, -0.43388509315308638),
+        Point(-0.22252022466746321, -0.97493092109751989), Point(0.62349058875494778, -0.78183133237816294),
+        Point(0.9999951564461973, 2.0248023187336557e-06), Point(0.62349186324804151, 0.78183110416445833),
+        Point(-0.22252517261730473, 0.97492913020689376)};
+    Polygon polygon(first);
+    Polygon other(second);
+    CHECK(polygon.isCongruentTo(other));
+    CHECK(other.isCongruentTo(polygon));
+    CHECK(polygon.isSimilarTo(other));
+    std::reverse(second.begin(), second.end());
+    Polygon mirrored(second);
+    CHECK(polygon.isCongruentTo(mirrored));
+    other.scale(Point(0, 0), 3);
+    CHECK(polygon.isSimilarTo(other));
+    CHECK(!polygon.isCongruentTo(other));
+  }
+
+  // Nonagons whose sides pairwise agree with some rotation only up to an error above the
+  // tolerance at one place; tolerant KMP used to accept them.
+  void test_no_congruence_past_tolerance() {
+    std::vector<Point> first = {
+        Point(0.99999713111156652, -1.8033879452216162e-07), Point(0.76604567642936627, 0.64278999484017563),
+        Point(0.17364951369976545, 0.98481052342766351), Point(-0.49999830633817111, 0.8660250995678036),
+        Point(-0.93969272947769511, 0.34201887661473673), Point(-0.93969392386862205, -0.34202316833601826),
+        Point(-0.49999633056857157, -0.86602758672412683), Point(0.17364513878808122, -0.98481146451732138),
+        Point(0.76604780687872465, -0.64278397245136398)};
+    std::vector<Point> second = {
+        Point(0.17365006731422372, 0.98480944056000552), Point(-0.50000217419108328, 0.86602866253390287),
+        Point(-0.93969341162000553, 0.34201620442604863), Point(-0.93969567201371618, -0.34201983230818866),
+        Point(-0.49999961485858491, -0.86602582839128062), Point(0.173645235707267, -0.98481150434515086),
+        Point(0.76604701138329856, -0.64278658551812573), Point(0.99999588047743915, 3.4729498663250926e-06),
+        Point(0.76604702914873679, 0.64279045096162513)};
+    Polygon polygon(first);
+    Polygon other(second);
+    CHECK(!polygon.isCongruentTo(other));
+  }
+
+  // A square with a smaller one cut out of its middle: the outline and the hole come back as two
+  // polygons, told apart by the sign of their area.
+  void test_difference_with_hole() {
+    Polygon outer(Point(0, 0), Point(4, 0), Point(4, 4), Point(0, 4));
+    Polygon inner(Point(1, 1), Point(1, 2), Point(2, 2), Point(2, 1));
+    CHECK(inner.signedArea() == -1);
+    std::vector<Polygon> result = combine(outer, inner, BooleanOperation::Difference);
+    CHECK(result.size() == 2);
+    double total = 0;
+    size_t holes = 0;
+    for (const Polygon& polygon : result) {
+      total += polygon.signedArea();
+      holes += polygon.signedArea() < 0;
+    }
+    CHECK(holes == 1);
+    CHECK(std::fabs(total - 15) < 1e-9);
+  }
+}
+
+int main() {
+  test_congruence_within_tolerance();
+  test_no_congruence_past_tolerance();
+  test_difference_with_hole();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}